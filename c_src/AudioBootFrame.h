@@ -0,0 +1,109 @@
+/*
+  AudioBootFrame.h - frame format of the audio bootloader
+
+  Shared by the bootloader ( TinyAudioBoot.c ), the host simulation and the
+  native encoder ( host/hex2wav.cpp ), so the receiver and the encoders use
+  the same layout, command codes and checksum. The header is plain C for
+  avr-gcc, C++ code gets the same definitions as constexpr functions and
+  compile time checks. The Java generator mirrors it in wavCreator/BootFrame.java.
+
+  A frame is sent as differential manchester code ( inverted, MSB first ):
+  SYNCBITS 0 bits or more, one 1 bit as start bit, then the frame bytes.
+  With USE_SHORTSYNC only the first frame needs SYNCBITS, the bit time is kept
+  and the following frames start with SHORTSYNCBITS 0 bits.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#ifndef AUDIOBOOTFRAME_H
+#define AUDIOBOOTFRAME_H
+
+#include <stdint.h>
+
+// frame format definition: indices
+#define COMMAND         0
+#define PAGEINDEXLOW    1  // page address lower part
+#define PAGEINDEXHIGH   2  // page address higher part
+#define LENGTHLOW       3
+#define LENGTHHIGH      4
+#define CRCLOW          5  // checksum lower part
+#define CRCHIGH         6  // checksum higher part
+#define DATAPAGESTART   7  // start of data
+
+#define PAGESIZE        64 // data bytes of a PROGCOMMAND frame, one flash page ( SPM_PAGESIZE of the Attiny85 )
+
+// bootloader commands
+#define NOCOMMAND       0
+#define TESTCOMMAND     1
+#define PROGCOMMAND     2
+#define RUNCOMMAND      3
+#define EEPROMCOMMAND   4
+#define EXITCOMMAND     5
+#define COMPRESSEDCOMMAND 6 // LZ compressed data of several pages, see decompressPages()
+                            // the frame ends after LENGTHLOW data bytes
+#define MULTIPAGECOMMAND 7  // header, then one block of checksum and data per page
+#define SYMBOLMODECOMMAND 8 // the following frames are sent as 4 level symbols
+#define IMAGECOMMAND    9   // start of a chapter of a resumable session
+
+#define COMPRESSIONMINMATCH 3   // shortest match of the LZ code of COMPRESSEDCOMMAND frames
+
+#define FECLANES        4       // forward error correction: syndrome bytes, then one parity byte
+#define LEGACYCRC       0x55AA  // checksum of every frame of the old generators
+#define SYNCBITS        40      // 0 bits of the synchronisation before the start bit
+#define SHORTSYNCBITS   8       // 0 bits before the start bit of the following frames of a session ( USE_SHORTSYNC )
+#define SHORTSYNCGUARD  4       // of these the receiver checks before it searches the start bit
+
+// amplitude of the 4 level symbols in 1/10 of the full amplitude
+#define SYMBOLLEVEL(n)  (4 + 2 * (n))
+// decision level of the receiver between the symbols n-1 and n in 1/20 of the full amplitude: 10, 14 and 18
+#define SYMBOLTHRESHOLD(n) (SYMBOLLEVEL((n) - 1) + SYMBOLLEVEL(n))
+
+#ifdef __cplusplus
+  #define FRAMECONSTEXPR constexpr
+#else
+  #define FRAMECONSTEXPR
+#endif
+
+// crc16 of _crc_ccitt_update() ( avr-libc ), polynomial 0x8408, start value 0xFFFF
+#ifdef __AVR__
+  #include <util/crc16.h>
+  #define frameCrcUpdate(crc, data) _crc_ccitt_update(crc, data)
+#else
+static inline FRAMECONSTEXPR uint16_t frameCrcUpdate(uint16_t crc, uint8_t data)
+{
+  data ^= crc & 0xFF;
+  data ^= data << 4;
+
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+#endif
+
+// checksum of a frame: all bytes from COMMAND to the end of the data without CRCLOW and CRCHIGH
+static inline FRAMECONSTEXPR uint16_t frameCrc(const uint8_t *frame, uint16_t size)
+{
+  uint16_t crc = 0xFFFF;
+
+  for (uint16_t n = 0; n < size; n++)
+  {
+    if (n != CRCLOW && n != CRCHIGH) crc = frameCrcUpdate(crc, frame[n]);
+  }
+  return crc;
+}
+
+#ifdef __cplusplus
+namespace audioboot
+{
+  constexpr uint16_t crc(const char *s, uint16_t crc = 0xFFFF)
+  {
+    return *s ? audioboot::crc(s + 1, frameCrcUpdate(crc, (uint8_t)*s)) : crc;
+  }
+
+  static_assert(crc("123456789") == 0x6F91, "check value of the CRC-16/MCRF4XX ( _crc_ccitt_update )");
+  static_assert(DATAPAGESTART == CRCHIGH + 1, "the data follows the checksum");
+  static_assert(SYMBOLLEVEL(3) == 10, "the highest symbol has the full amplitude");
+}
+#endif
+
+#endif
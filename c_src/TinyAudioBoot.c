@@ -161,6 +161,8 @@
 #include <avr/boot.h>
 #include <avr/pgmspace.h>
 #include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include "AudioBootFrame.h" // frame layout, commands and checksum
 
 // This value has to be adapted to the bootloader size
 // If you change this, please change BOOTLOADER_ADDRESS on Makefile too
@@ -196,7 +198,20 @@ uint16_t resetVector RESET_SECTION = RJMP + BOOTLOADER_ADDRESS / 2;
 	#define TOGGLEDEBUGPIN 
 	
 #endif
-	
+
+// hooks for the firmware-in-the-loop simulation on the host, see host/hostsim.h
+#ifdef HOSTSIM
+
+	#define SIMFRAME(ok)       sim_frame(FrameData, FRAMESIZE, ok);
+	#define STARTAPPLICATION   sim_start_application((uint32_t)(uintptr_t)start_appl_main);
+
+#else
+
+	#define SIMFRAME(ok)
+	#define STARTAPPLICATION   (*start_appl_main) ();
+
+#endif
+
 	
 #define USELED
 #ifdef USELED
@@ -225,7 +240,30 @@ uint16_t resetVector RESET_SECTION = RJMP + BOOTLOADER_ADDRESS / 2;
 #define SKIPPERPINVALUE (PINB&SKIPPERPIN)
 
 #define INPUTAUDIOPIN (1<<PB3) //
-#define PINVALUE (PINB&INPUTAUDIOPIN)
+
+// Adaptive slicer: the audio pin is read by the free running ADC instead of the digital
+// input buffer. The switching level is set to the middle between minimum and maximum
+// of each preamble, so decoding does not depend on the volume setting.
+// Needs a bigger bootloader section ( BOOTLOADER_ADDRESS 0x1800 )
+//#define USE_ADC_SLICER
+#define SLICERMINSWING 8  // smallest peak to peak value of a signal in ADC counts
+
+// Timer1 clocked by the 64MHz PLL measures the bit times with 62.5ns resolution instead of
+// 0.5us. The 8 bit counter is extended to 16 bit in software, see timer1(), so it
+// also covers bit times above 128us ( half speed ).
+//#define USE_TIMER1
+
+#ifdef USE_ADC_SLICER
+  #define PINVALUE sliceAdc()
+#else
+  #define PINVALUE (PINB&INPUTAUDIOPIN)
+#endif
+#ifdef USE_TIMER1
+  // waiting for an edge which ends a time measurement keeps the timer extension up to date
+  #define TIMEDPINVALUE (timer1(), PINVALUE)
+#else
+  #define TIMEDPINVALUE PINVALUE
+#endif
 #define INITAUDIOPORT {DDRB&=~INPUTAUDIOPIN;} // audio pin is input
 
 #define PINLOW (PINVALUE==0)
@@ -234,6 +272,23 @@ uint16_t resetVector RESET_SECTION = RJMP + BOOTLOADER_ADDRESS / 2;
 #define WAITBLINKTIME 10000
 #define BOOT_TIMEOUT  50
 
+// Fast start: instead of the skip check and the wait for a signal the bootloader is only
+// entered if the audio pin toggles within a short window after reset, see fastStart().
+// The window in ms is the EEPROM byte FASTSTARTCONFIG: 0xFF ( erased ) uses FASTSTARTWINDOW,
+// 0 switches back to the skip check and the normal wait. An eep file in the wav can set it.
+//#define USE_FASTSTART
+#define FASTSTARTWINDOW 5       // ms
+#define FASTSTARTEDGES  8       // pin changes needed to start the bootloader
+#define FASTSTARTCONFIG E2END   // last EEPROM byte
+
+// Low power wait: while the bootloader waits for a signal the CPU sleeps until the audio
+// pin changes or the watchdog ends the blink period of 0.5s, see sleepUntilSignal().
+// SLEEP_MODE_IDLE wakes up within a few cycles. SLEEP_MODE_PWR_DOWN also stops the clock
+// and needs the start-up time set by the fuses ( 1K CK, 64us with lfuse 0xE1 ) after the
+// first edge, which is part of the preamble.
+//#define USE_SLEEP
+#define SLEEPMODE SLEEP_MODE_PWR_DOWN
+
 #define true (1==1)
 #define false !true
 
@@ -241,30 +296,139 @@ uint16_t resetVector RESET_SECTION = RJMP + BOOTLOADER_ADDRESS / 2;
 // main loop
 //***************************************************************************************
 
-#define TIMER TCNT0 // we use timer1 for measuring time
-
-// frame format definition: indices
-#define COMMAND         0
-#define PAGEINDEXLOW    1  // page address lower part
-#define PAGEINDEXHIGH   2  // page address higher part
-#define LENGTHLOW       3
-#define LENGTHHIGH      4
-#define CRCLOW          5  // checksum lower part 
-#define CRCHIGH         6  // checksum higher part 
-#define DATAPAGESTART   7  // start of data
-#define PAGESIZE        SPM_PAGESIZE
-#define FRAMESIZE       (PAGESIZE+DATAPAGESTART) // size of the data block to be received
-
-// bootloader commands
-#define NOCOMMAND       0
-#define TESTCOMMAND     1
-#define PROGCOMMAND     2
-#define RUNCOMMAND      3
-#define EEPROMCOMMAND   4
-#define EXITCOMMAND     5
+#ifdef USE_TIMER1
+  #define TIMER (*timer1())
+  #define TIMERVALUE uint16_t
+  #define TIMERSCALE 8 // timer ticks per 0.5us
+#else
+  #define TIMER TCNT0 // we use timer1 for measuring time
+  #define TIMERVALUE uint8_t
+  #define TIMERSCALE 1
+#endif
+
+// frame format: see AudioBootFrame.h
+#if PAGESIZE != SPM_PAGESIZE
+  #error "PAGESIZE of AudioBootFrame.h has to be the flash page size of the MCU"
+#endif
+
+// Forward error correction, the wav file has to be generated with FEC enabled too.
+// The frame bits are interleaved into FECLANES lanes. For every lane the syndrome
+// ( xor of the positions of all 1 bits ) and the parity are sent at the end of the frame.
+// One wrong bit per lane is corrected, bursts of up to FECLANES wrong bits are repaired.
+//#define USE_FEC
+#ifdef USE_FEC
+  // bits per lane (PAGESIZE+DATAPAGESTART)*8/FECLANES must be < 256
+  #define FECSIZE       (FECLANES+1)
+#else
+  #define FECSIZE       0
+#endif
+#define FRAMESIZE     (PAGESIZE+DATAPAGESTART+FECSIZE) // size of the data block to be received
+
+// The checksum is a CRC16 ( _crc_ccitt_update, start value 0xFFFF ) over the whole frame
+// without the two checksum bytes. With CHECKCRC frames with a wrong checksum are never
+// programmed, wav files of old generators which always send LEGACYCRC ( 0x55AA ) are rejected.
+// The check makes the bootloader bigger, see avr-size for the section of your pinout.
+//#define CHECKCRC
+
+// Pages which are already in the flash and EEPROM bytes which already have the value are
+// not written again: saves 9ms CPU halt and an erase cycle per page. Makes the bootloader bigger.
+//#define USE_SKIPUNCHANGED
+
+// Decoder for compressed frames. This needs a bigger bootloader section ( BOOTLOADER_ADDRESS 0x1800 )
+//#define USE_COMPRESSION
+
+// Several pages in one frame: after the header ( LENGTH = number of data bytes ) each page
+// follows as a block of checksum and data, see receivePages()
+//#define USE_MULTIPAGE
+
+// 4 level amplitude symbols sampled by the ADC: 2 bits per symbol instead of 1 bit per
+// manchester bit. A SYMBOLMODECOMMAND frame switches all following frames of the wav
+// to symbols, see receiveSymbolFrame(). Needs a bigger bootloader section.
+//#define USE_ADC_SYMBOLS
+
+// EEPROM frames are written while the next frame is received instead of blocking the
+// reception for 3.4ms per byte, see eepromPoll(). The wav file has to be generated with
+// the shorter EEPROM gaps ( WavCodeGenerator.setEepromQueue ) to gain from this.
+//#define USE_EEPROMQUEUE
+
+// Resumable sessions: each chapter of the wav starts with an IMAGECOMMAND frame which carries
+// the image id ( PAGEINDEX ), the image length ( LENGTH ) and the first word of the image.
+// The pages written for this id are marked in the EEPROM, so an interrupted playback can be
+// started again at any chapter after a reset. Marked pages are skipped, the application is
+// only started when all pages of the image are written, see resumeImage().
+// The EEPROM bytes from RESUMESTATE on can not be used by the application or an eep file,
+// the generators reject eep data there for a wav file with chapters.
+// Needs a bigger bootloader section.
+//#define USE_RESUME
+#define RESUMESTATE     (E2END + 1 - 32)                            // image id, then the page bitmap
+#define RESUMEPAGES     (BOOTLOADER_ADDRESS / SPM_PAGESIZE)
+#define RESUMESIZE      (2 + (RESUMEPAGES + 7) / 8)
+
+// Short synchronisation: only the first frame of a session measures the bit time on the
+// preamble. The following frames keep DelayTime ( and the slicer levels ) and need only
+// SHORTSYNCBITS 0 bits before the start bit, receiveBlock() finds the phase on them.
+// The wav file has to be generated with WavCodeGenerator.setShortSync to gain from this,
+// wav files with the full preamble on every frame are received as well.
+//#define USE_SHORTSYNC
+
+#if defined(USE_ADC_SYMBOLS) && defined(USE_ADC_SLICER)
+  #error "the symbol mode needs single ADC conversions, the slicer a free running ADC"
+#endif
+#if defined(USE_SLEEP) && defined(USE_ADC_SLICER)
+  #error "the sleep mode wakes up by the digital input buffer, the slicer reads the ADC"
+#endif
 
 uint8_t FrameData[ FRAMESIZE ];
 
+uint16_t SkippedPages; // pages not programmed because the flash content was already identical
+uint16_t DelayTime;    // 3/4 bit time in timer ticks, measured at the start of each frame
+                       // ( USE_SHORTSYNC: of the first frame, 0 until then )
+
+// Clock tracking: the bit time is measured between the middles of two bits and
+// follows slow changes of the sound card clock during long ( multi page ) frames.
+//#define USE_CLOCKTRACKING
+#ifdef USE_CLOCKTRACKING
+uint16_t BitTime;           // bit time in 1/8 timer ticks
+uint16_t SyncDelayTime;     // DelayTime measured by the synchronisation of the frame
+uint16_t ClockCorrection;   // largest deviation from SyncDelayTime since reset, in timer ticks
+#endif
+
+#ifdef USE_ADC_SYMBOLS
+uint8_t SymbolMode;            // true: frames are received as amplitude symbols
+TIMERVALUE QuarterSymbol;      // timer ticks from the middle of a symbol to the middle of its second half
+TIMERVALUE ThreeQuarterSymbol; // timer ticks from the middle of a symbol to the middle of the next first half
+uint8_t SymbolFirstHalf;       // ADC value of the first half of the next symbol
+#endif
+
+#ifdef USE_TIMER1
+uint16_t TimerCount; // Timer1 extended to 16 bit
+uint8_t  TimerLast;  // TCNT1 at the last update of TimerCount
+
+// Timer1 counts the PLL clock / 4. The counter wraps every 16us, so all loops which
+// measure a time read the timer ( or TIMEDPINVALUE ) at least that often.
+// The timer can be written like TCNT0, the count restarts from the current counter value.
+inline uint16_t *timer1()
+{
+  uint8_t now = TCNT1;
+
+  TimerCount += (uint8_t)(now - TimerLast);
+  TimerLast = now;
+  return &TimerCount;
+}
+#endif
+
+#ifdef USE_ADC_SLICER
+uint8_t SliceLow;    // the pin value changes to low below this ADC value
+uint8_t SliceHigh;   // and to high above this one
+uint8_t SliceValue;
+#endif
+
+#ifdef USE_FEC
+uint8_t  FecSyndrome[ FECLANES ];
+uint8_t  FecParity;
+uint16_t FecCorrections; // number of corrected bits since reset
+#endif
+
 #define FLASH_RESET_ADDR        0x0000                 // address of reset vector (in bytes)
 #define BOOTLOADER_STARTADDRESS BOOTLOADER_ADDRESS    // start address:
 #define BOOTLOADER_ENDADDRESS   0x2000                // end address:   0x2000 = 8192
@@ -303,104 +467,524 @@ inline void eeprom_write(unsigned short address, unsigned char data)
    EECR |= (1<<EEPE);  
 }
 
+#ifdef USE_EEPROMQUEUE
 //***************************************************************************************
-// receiveFrame()
-//
-// This routine receives a differential manchester coded signal at the input pin.
-// The routine waits for a toggling voltage level.
-// It automatically detects the transmission speed.
+// eepromPoll()
 //
-// output:    uint8_t flag:     true: checksum OK
-//            uint8_t FramData: global data buffer
+// Called between the received bits: if no EEPROM write is running, the next byte of
+// the queue is compared with the EEPROM and its write is started if it differs.
+//***************************************************************************************
+uint8_t  EepromQueue[PAGESIZE];
+uint8_t  EepromQueueIndex;   // next byte to write
+uint8_t  EepromQueueLength;  // number of bytes in the queue
+uint16_t EepromQueueAddress; // EEPROM address of EepromQueue[0]
+
+#define EEPROMPOLL eepromPoll();
+
+inline void eepromPoll()
+{
+  if (EepromQueueIndex < EepromQueueLength && !(EECR & (1 << EEPE)))
+  {
+    uint16_t address = EepromQueueAddress + EepromQueueIndex;
+    uint8_t data = EepromQueue[EepromQueueIndex++];
+
+    if (eeprom_read_byte((uint8_t *)(uintptr_t)address) != data) eeprom_write(address, data);
+  }
+}
+
+// write the rest of the queue, before the queue is refilled or the bootloader is left
+void eepromFlush()
+{
+  while (EepromQueueIndex < EepromQueueLength) eepromPoll();
+}
+#else
+#define EEPROMPOLL
+#endif
+
+#ifdef USE_RESUME
+//***************************************************************************************
+// resumable sessions
 //
+// RESUMESTATE holds the id of the image which is being programmed ( 0xFFFF: none ) and
+// one bit per page, cleared when the page is written. An IMAGECOMMAND frame with another
+// id starts a new session. The id is erased when the application is started, the bitmap
+// is left for the next session to erase.
 //***************************************************************************************
-inline uint8_t receiveFrame()
+uint8_t  ResumeActive;   // an IMAGECOMMAND frame was received since reset
+uint16_t ResumePages;    // number of pages of the image
+uint16_t ResumeVector;   // first word of the image: the reset vector of the application
+
+#define RESUMEMARK(page) resumeMark(page);
+
+inline uint16_t resumeId()
 {
-  //uint16_t store[16];
+  return eeprom_read_byte((uint8_t *)RESUMESTATE) | (eeprom_read_byte((uint8_t *)RESUMESTATE + 1) << 8);
+}
 
-  uint16_t counter = 0;
-  volatile uint16_t time = 0;
-  volatile uint16_t delayTime;
-  uint8_t p, t;
-  uint8_t k = 8;
-  uint8_t dataPointer = 0;
-  uint16_t n;
+inline uint8_t resumeDone(uint16_t page)
+{
+  uint16_t address = RESUMESTATE + 2 + page / 8;
 
-  //*** synchronisation and bit rate estimation **************************
-  time = 0;
-  // wait for edge
-  p = PINVALUE;
-  while (p == PINVALUE);
+  return ResumeActive && !(eeprom_read_byte((uint8_t *)(uintptr_t)address) & (1 << (page & 7)));
+}
 
-  p = PINVALUE;
+inline void resumeMark(uint16_t page)
+{
+  uint16_t address = RESUMESTATE + 2 + page / 8;
 
-  TIMER = 0; // reset timer
-  for (n = 0; n < 16; n++)
+  // the write runs while the next frame is received
+  if (ResumeActive) eeprom_write(address, eeprom_read_byte((uint8_t *)(uintptr_t)address) & ~(1 << (page & 7)));
+}
+
+void resumeImage(uint16_t id, uint16_t length, uint8_t *buf)
+{
+  if (resumeId() != id)
   {
-    // wait for edge
-    while (p == PINVALUE);
-    t = TIMER;
-    TIMER = 0; // reset timer
-    p = PINVALUE;
+    // the wav file leaves RESUMESIZE EEPROM write times for this
+    for (uint16_t address = RESUMESTATE + 2; address < RESUMESTATE + RESUMESIZE; address++)
+    {
+      if (eeprom_read_byte((uint8_t *)(uintptr_t)address) != 0xFF) eeprom_write(address, 0xFF);
+    }
+    eeprom_write(RESUMESTATE, id);
+    eeprom_write(RESUMESTATE + 1, id >> 8);
+  }
+  ResumePages = (length + SPM_PAGESIZE - 1) / SPM_PAGESIZE;
+  ResumeVector = buf[0] | (buf[1] << 8);
+  ResumeActive = true;
+}
 
-    //store[counter++] = t;
+uint8_t resumeComplete()
+{
+  for (uint16_t page = 0; page < ResumePages; page++)
+  {
+    if (!resumeDone(page)) return false;
+  }
+  return true;
+}
+#else
+#define RESUMEMARK(page)
+#endif
 
-    if (n >= 8)time += t; // time accumulator for mean period calculation only the last 8 times are used
+#ifdef USE_FEC
+//***************************************************************************************
+// uint8_t fecCorrect(uint8_t start, uint8_t end)
+//
+// Correct the received block in place, the FEC data follows the block data.
+// Bit n of the block belongs to lane n%FECLANES at position n/FECLANES+1.
+// Wrong parity of a lane: the difference of the received and the calculated syndrome
+// is the position of the wrong bit. A wrong syndrome with correct parity can not be
+// corrected, this is left to the checksum.
+//
+// input:  first and last+1 byte of the block in FrameData
+// output: number of corrected bits
+//***************************************************************************************
+uint8_t fecCorrect(uint8_t start, uint8_t end)
+{
+  uint8_t lane, position;
+  uint8_t corrected = 0;
+  uint16_t bit;
+
+  FecParity ^= FrameData[end + FECLANES];
+
+  for (lane = 0; lane < FECLANES; lane++)
+  {
+    position = FecSyndrome[lane] ^ FrameData[end + lane];
+
+    if ((FecParity & (1 << lane)) && position != 0 && position <= (end - start) * (8 / FECLANES))
+    {
+      bit = (uint16_t)(position - 1) * FECLANES + lane;
+      FrameData[start + bit / 8] ^= 0x80 >> (bit % 8);
+      corrected++;
+    }
   }
+  FecCorrections += corrected;
+  return corrected;
+}
+#endif
 
-  delayTime = time * 3 / 4 / 8;
-  // delay 3/4 bit
-  while (TIMER < delayTime);
+#ifdef USE_ADC_SLICER
+// the last ADC result compared to the switching levels, same values as the pin
+uint8_t sliceAdc()
+{
+  uint8_t a = ADCH;
+
+  if (a > SliceHigh) SliceValue = INPUTAUDIOPIN;
+  if (a < SliceLow) SliceValue = 0;
+  return SliceValue;
+}
 
-  //p=1;
+//***************************************************************************************
+// measureSlicerLevels()
+//
+// Minimum and maximum of the signal over 4 periods of 125us at the start of the
+// preamble. The measurement is repeated until the peak to peak value is at least
+// SLICERMINSWING, so noise between the frames is not taken as signal.
+// The switching levels are set 1/8 of the peak to peak value above and below the middle.
+//
+//***************************************************************************************
+void measureSlicerLevels()
+{
+  uint8_t a, n, minimum, maximum, hysteresis;
+
+  do
+  {
+    minimum = 255;
+    maximum = 0;
+    for (n = 0; n < 4; n++)
+    {
+      TIMER = 0;
+      while (TIMER < 250 * TIMERSCALE)
+      {
+        a = ADCH;
+        if (a < minimum) minimum = a;
+        if (a > maximum) maximum = a;
+      }
+    }
+  } while ((uint8_t)(maximum - minimum) < SLICERMINSWING);
+
+  hysteresis = (uint8_t)(maximum - minimum) * 3 / 8;
+  SliceLow = minimum + hysteresis;
+  SliceHigh = maximum - hysteresis;
+}
+#endif
+
+//***************************************************************************************
+// uint16_t threeQuarterBit(uint16_t time)
+//
+// int has 16 bit on the AVR: time * 3 overflows with USE_TIMER1 as soon as a bit is
+// longer than 170us. The bit time is divided first, each step is held in a uint16_t,
+// so the host simulation ( 32 bit int ) computes the same values as the bootloader.
+//
+// input:     sum of 8 bit times in timer ticks
+// output:    3/4 bit time in timer ticks
+//
+//***************************************************************************************
+static inline uint16_t threeQuarterBit(uint16_t time)
+{
+  uint16_t bitTime = time / 8;
+  uint16_t threeQuarters = bitTime * 3;
+
+  return threeQuarters / 4;
+}
+
+//***************************************************************************************
+// receiveBlock(uint8_t start, uint8_t end)
+//
+// Wait for the start bit and receive the bytes FrameData[start..end-1], followed by
+// the FEC data. The bit time of the last synchronisation is used, so a block can
+// follow after any number of 0 bits, e.g. while the CPU is halted by programming.
+// The first edge is always taken as the middle of a 0 bit.
+//
+// input:     first and last+1 byte of the block in FrameData
+// output:    uint8_t flag:     true: checksum OK ( bytes CRCLOW and CRCHIGH )
+//
+//***************************************************************************************
+uint8_t receiveBlock(uint8_t start, uint8_t end)
+{
+  uint8_t p, t;
+  uint8_t k;
+  uint8_t dataPointer = start;
+  uint16_t n;
+  uint16_t crc = 0xFFFF;
+#ifdef USE_CLOCKTRACKING
+  TIMERVALUE bitTime;
+  uint16_t deviation;
+#endif
 
   //****************** wait for start bit ***************************
-  while (p == PINVALUE) // while not startbit ( no change of pinValue means 0 bit )
+  // always start with an edge: after programming the block may be entered at any time
+  p = PINVALUE;
+  do
   {
     // wait for edge
     while (p == PINVALUE);
-    p = PINVALUE;
     TIMER = 0;
+    p = PINVALUE;
 
     // delay 3/4 bit
-    while (TIMER < delayTime);
+    while (TIMER < DelayTime);
     TIMER = 0;
-
-    counter++;
-  }
+    EEPROMPOLL
+  } while (p == PINVALUE); // while not startbit ( no change of pinValue means 0 bit )
   p = PINVALUE;
   
   //****************************************************************
   //receive data bits
+#ifdef USE_FEC
+  for (k = 0; k < FECLANES; k++) FecSyndrome[k] = 0;
+  FecParity = 0;
+#endif
   k = 8;
-  for (n = 0; n < (FRAMESIZE * 8); n++)
+  for (n = 0; n < (uint16_t)(end - start + FECSIZE) * 8; n++)
   {
     // wait for edge
+#ifdef USE_CLOCKTRACKING
+    while (p == TIMEDPINVALUE);
+    bitTime = TIMER;
+#else
     while (p == PINVALUE);
+#endif
     TIMER = 0;
     p = PINVALUE;
 
+#ifdef USE_CLOCKTRACKING
+    // software PLL: the edge is always the middle of a bit, one bit time after the
+    // last one ( except for the first bit, the timer was reset after the start bit delay )
+    if (n != 0)
+    {
+      BitTime += ((int16_t)(bitTime * 8 - BitTime)) / 8;
+      DelayTime = threeQuarterBit(BitTime);
+    }
+#endif
+
+    // a byte is complete: update the checksum in the idle time before the sample point
+    if (k == 0) {
+      if ((uint8_t)(dataPointer - CRCLOW) > 1 && dataPointer < end) crc = frameCrcUpdate(crc, FrameData[dataPointer]);
+      dataPointer++;
+      k = 8;
+#if defined(USE_COMPRESSION) || defined(USE_MULTIPAGE)
+      // the header is complete: compressed frames are shorter, multi page frames continue with page blocks
+      if (dataPointer == CRCLOW)
+      {
+#ifdef USE_COMPRESSION
+        if (FrameData[COMMAND] == COMPRESSEDCOMMAND && FrameData[LENGTHLOW] < PAGESIZE) end = DATAPAGESTART + FrameData[LENGTHLOW];
+#endif
+#ifdef USE_MULTIPAGE
+        if (FrameData[COMMAND] == MULTIPAGECOMMAND) end = DATAPAGESTART;
+#endif
+      }
+#endif
+    };
+
     // delay 3/4 bit
-    while (TIMER < delayTime);
+    while (TIMER < DelayTime);
 
     t = PINVALUE;
-	  
-
-    counter++;
 
     FrameData[dataPointer] = FrameData[dataPointer] << 1;
-    if (p != t) FrameData[dataPointer] |= 1;
+    if (p != t)
+    {
+      FrameData[dataPointer] |= 1;
+#ifdef USE_FEC
+      if (dataPointer < end)
+      {
+        FecSyndrome[n % FECLANES] ^= (uint8_t)(n / FECLANES) + 1;
+        FecParity ^= 1 << (n % FECLANES);
+      }
+#endif
+    }
     p = t;
     k--;
-    if (k == 0) {
-      dataPointer++;
-      k = 8;
-    };
+    EEPROMPOLL
   }
-  //uint16_t crc = (uint16_t)FrameData[CRCLOW] + FrameData[CRCHIGH] * 256;
-  
-  
+#ifdef USE_CLOCKTRACKING
+  deviation = DelayTime > SyncDelayTime ? DelayTime - SyncDelayTime : SyncDelayTime - DelayTime;
+  if (deviation > ClockCorrection) ClockCorrection = deviation;
+#endif
+#ifndef USE_FEC
+  if ((uint8_t)(dataPointer - CRCLOW) > 1) crc = frameCrcUpdate(crc, FrameData[dataPointer]); // last data byte
+#else
+  if (fecCorrect(start, end))
+  {
+    // checksum of the corrected block
+    crc = 0xFFFF;
+    for (dataPointer = start; dataPointer < end; dataPointer++)
+    {
+      if ((uint8_t)(dataPointer - CRCLOW) > 1) crc = frameCrcUpdate(crc, FrameData[dataPointer]);
+    }
+  }
+#endif
+
+#ifdef CHECKCRC
+  return crc == (uint16_t)FrameData[CRCLOW] + FrameData[CRCHIGH] * 256;
+#else
+  return true;
+#endif
+}
+
+#ifdef USE_ADC_SYMBOLS
+uint8_t adcConvert()
+{
+  ADCSRA |= (1 << ADSC);
+  while (ADCSRA & (1 << ADSC));
+  return ADCH;
+}
+
+//***************************************************************************************
+// int16_t receiveSymbol()
+//
+// A symbol is one bit time long. The first half is above the bias level, the second
+// half the same amount below, so the symbol has no DC part and the input pin
+// always falls in the middle of the symbol.
+// The ADC samples the middle of the second half and the middle of the first half of
+// the next symbol. The difference of the two halves does not depend on the bias.
+//
+// output:    difference of the first and the second half of the symbol
+//
+//***************************************************************************************
+int16_t receiveSymbol()
+{
+  int16_t difference;
+
+  while (PINVALUE);  // falling edge in the middle of the symbol
+  TIMER = 0;
+  while (TIMER < QuarterSymbol);
+  difference = SymbolFirstHalf - adcConvert();
+  while (TIMER < ThreeQuarterSymbol);
+  SymbolFirstHalf = adcConvert();
+
+  return difference;
+}
+
+//***************************************************************************************
+// receiveSymbolFrame()
+//
+// Receives a frame of 4 level symbols. The amplitudes of the levels are
+// 0.4, 0.6, 0.8 and 1.0 of the full amplitude, 4 symbols are one byte, MSB first.
+// The frame starts with full amplitude symbols for synchronisation and as amplitude
+// reference, followed by one symbol with the lowest level as start symbol.
+// The frame has the normal layout without forward error correction.
+//
+// The input circuit must not invert the signal, otherwise the halves of
+// neighbouring symbols are combined. For an inverting circuit the wav generator
+// inverts the symbols ( WavCodeGenerator.setInvertSymbols, hex2wav -i ).
+//
+// output:    uint8_t flag:     true: checksum OK
+//            uint8_t FramData: global data buffer
+//
+//***************************************************************************************
+uint8_t receiveSymbolFrame()
+{
+  uint16_t time = 0;
+  uint16_t reference = 0;
+  int16_t threshold1, threshold2, threshold3, difference;
+  uint16_t crc = 0xFFFF;
+  uint8_t n, k, data = 0;
+  TIMERVALUE t;
+
+  //*** synchronisation and symbol rate estimation ***********************
+  while (!PINVALUE);
+  while (PINVALUE);
+  TIMER = 0;
+  for (n = 0; n < 16; n++)
+  {
+    while (!TIMEDPINVALUE);
+    while (TIMEDPINVALUE);  // falling edge in the middle of the symbol
+    t = TIMER;
+    TIMER = 0;
+    if (n >= 8) time += t;
+  }
+  QuarterSymbol = time / 4 / 8;
+  ThreeQuarterSymbol = threeQuarterBit(time);
+  while (TIMER < ThreeQuarterSymbol);
+  SymbolFirstHalf = adcConvert();
+
+  //*** amplitude reference and decision thresholds between the levels ***
+  for (n = 0; n < 8; n++) reference += receiveSymbol();
+  // reference is 8 times the full amplitude ( max. 8*255 ), reference * 18 fits in 16 bits
+  threshold1 = reference * SYMBOLTHRESHOLD(1) / (16 * SYMBOLLEVEL(3));  // 0.5 of the full amplitude
+  threshold2 = reference * SYMBOLTHRESHOLD(2) / (16 * SYMBOLLEVEL(3));  // 0.7
+  threshold3 = reference * SYMBOLTHRESHOLD(3) / (16 * SYMBOLLEVEL(3));  // 0.9
+
+  while (receiveSymbol() > threshold1); // start symbol
+
+  for (n = 0; n < PAGESIZE + DATAPAGESTART; n++)
+  {
+    for (k = 0; k < 4; k++)
+    {
+      difference = receiveSymbol();
+      data = (data << 2) | ((difference > threshold1) + (difference > threshold2) + (difference > threshold3));
+      EEPROMPOLL
+    }
+    FrameData[n] = data;
+    if ((uint8_t)(n - CRCLOW) > 1) crc = frameCrcUpdate(crc, data);
+  }
+
+#ifdef CHECKCRC
+  return crc == (uint16_t)FrameData[CRCLOW] + FrameData[CRCHIGH] * 256;
+#else
   return true;
+#endif
+}
+#endif
+
+//***************************************************************************************
+// receiveFrame()
+//
+// This routine receives a differential manchester coded signal at the input pin.
+// The routine waits for a toggling voltage level.
+// It automatically detects the transmission speed.
+//
+// output:    uint8_t flag:     true: checksum OK
+//            uint8_t FramData: global data buffer
+//
+//***************************************************************************************
+inline uint8_t receiveFrame()
+{
+  //uint16_t store[16];
+
+  volatile uint16_t time = 0;
+  uint8_t p;
+  TIMERVALUE t;
+  uint16_t n;
+
+#ifdef USE_ADC_SYMBOLS
+  if (SymbolMode) return receiveSymbolFrame();
+#endif
+#ifdef USE_SHORTSYNC
+  if (DelayTime)
+  {
+    // wait for the signal, then SHORTSYNCGUARD 0 bits in a row: a single edge at the end of the
+    // last frame or after a gap is not taken as the start bit. receiveBlock() needs one more 0 bit.
+    p = PINVALUE;
+    while (p == PINVALUE) EEPROMPOLL;
+    n = 0;
+    while (n < SHORTSYNCGUARD)
+    {
+      while (p == PINVALUE);
+      TIMER = 0;
+      p = PINVALUE;
+      while (TIMER < DelayTime);
+      n++;
+      if (p != PINVALUE) n = 0; // not a 0 bit
+      p = PINVALUE;
+    }
+    return receiveBlock(0, PAGESIZE + DATAPAGESTART);
+  }
+#endif
+#ifdef USE_ADC_SLICER
+  measureSlicerLevels();
+#endif
+
+  //*** synchronisation and bit rate estimation **************************
+  time = 0;
+  // wait for edge
+  p = PINVALUE;
+  while (p == PINVALUE) EEPROMPOLL;
+
+  p = PINVALUE;
+
+  TIMER = 0; // reset timer
+  for (n = 0; n < 16; n++)
+  {
+    // wait for edge
+    while (p == TIMEDPINVALUE);
+    t = TIMER;
+    TIMER = 0; // reset timer
+    p = PINVALUE;
+
+    //store[counter++] = t;
+
+    if (n >= 8)time += t; // time accumulator for mean period calculation only the last 8 times are used
+  }
+
+  DelayTime = threeQuarterBit(time);
+#ifdef USE_CLOCKTRACKING
+  BitTime = time; // sum of 8 bit times
+  SyncDelayTime = DelayTime;
+#endif
+
+  return receiveBlock(0, PAGESIZE + DATAPAGESTART);
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------
@@ -475,6 +1059,9 @@ pgm_write_block (uint16_t flash_addr, uint16_t * block, size_t size)
 //  void boot_program_page (uint32_t page, uint8_t *buf)
 //
 //  Erase and flash one page.
+//  With USE_SKIPUNCHANGED erase and write are skipped if the page in flash is
+//  already identical to the received data. This saves 9ms CPU halt time and
+//  one flash erase cycle.
 //
 //  input:     page address and data to be programmed
 //
@@ -484,32 +1071,55 @@ void boot_program_page (uint32_t page, uint8_t *buf)
   uint16_t i;
   cli(); // disable interrupts
 
-  boot_page_erase(page);
-  boot_spm_busy_wait ();      // Wait until the memory is erased.
+#ifdef USE_RESUME
+  if (resumeDone(page / SPM_PAGESIZE))
+  {
+    SkippedPages++; // written in an earlier session
+    return;
+  }
+#endif
 
+  //first page and first index is vector table... ( page 0 and index 0 )
+  if (page == 0)
+  {
+    uint16_t w = buf[0] + (buf[1] << 8);
+
+    //1.save jump to application vector for later patching
+    void* appl = (void *)(uintptr_t)(w - RJMP);
+    start_appl_main =  ((void (*)(void)) appl);
+
+    //2.replace w with jump vector to bootloader
+    w = 0xC000 + (BOOTLOADER_ADDRESS / 2) - 1;
+    buf[0] = w;
+    buf[1] = w >> 8;
+  }
+  // else if (page == LAST_PAGE && i == 60)
+  // {
+    //3.retrieve saved reset vector
+    // w = saved_reset_vector;
+  // }
+
+#ifdef USE_SKIPUNCHANGED
   for (i = 0; i < SPM_PAGESIZE; i += 2)
   {
-    //read received data
-    uint16_t w = *buf++; //low section
-    w += (*buf++) << 8; //high section
-    //combine low and high to get 16 bit
+    if (buf[i] + (buf[i + 1] << 8) != pgm_read_word ((uint16_t)page + i)) break;
+  }
+  if (i == SPM_PAGESIZE)
+  {
+    SkippedPages++;
+    RESUMEMARK(page / SPM_PAGESIZE)
+    return;
+  }
+#endif
 
-    //first page and first index is vector table... ( page 0 and index 0 )
-    if (page == 0 && i == 0)
-    {
-      
-      //1.save jump to application vector for later patching
-      void* appl = (void *)(w - RJMP);
-      start_appl_main =  ((void (*)(void)) appl);
+  eeprom_busy_wait();         // an EEPROM write blocks the SPM instruction
+  boot_page_erase(page);
+  boot_spm_busy_wait ();      // Wait until the memory is erased.
 
-      //2.replace w with jump vector to bootloader
-      w = 0xC000 + (BOOTLOADER_ADDRESS / 2) - 1;
-    }
-    // else if (page == LAST_PAGE && i == 60)
-    // {
-      //3.retrieve saved reset vector
-      // w = saved_reset_vector;
-    // }
+  for (i = 0; i < SPM_PAGESIZE; i += 2)
+  {
+    uint16_t w = *buf++;
+    w += (*buf++) << 8;
 
     boot_page_fill (page + i, w);
     boot_spm_busy_wait();       // Wait until the memory is written.
@@ -517,13 +1127,122 @@ void boot_program_page (uint32_t page, uint8_t *buf)
 
   boot_page_write (page);     // Store buffer in flash page.
   boot_spm_busy_wait();       // Wait until the memory is written.
+  RESUMEMARK(page / SPM_PAGESIZE)
+}
+
+#ifdef USE_COMPRESSION
+//***************************************************************************************
+//  void decompressPages (uint16_t address, uint8_t *src, uint8_t length)
+//
+//  Decode a compressed frame and program the pages one after another.
+//
+//  token format:
+//    0x00..0x7F  literal run: the next c+1 bytes are copied
+//    0x80..0xFF  match: (c&0x7F)+COMPRESSIONMINMATCH bytes are copied from
+//                "distance" bytes before, followed by distance low and high byte
+//
+//  Only the current page is held in SRAM, a match reaching further back is read
+//  from the pages programmed before. The generator never refers to the patched
+//  reset vector and ends a frame always on a page boundary.
+//
+//  input:     address of the first page, compressed data and its length
+//
+//***************************************************************************************
+uint8_t PageBuffer[ PAGESIZE ];
+
+void decompressPages (uint16_t address, uint8_t *src, uint8_t length)
+{
+  uint8_t *end = src + length;
+  uint8_t n = 0;
+
+  while (src < end)
+  {
+    uint8_t c = *src++;
+    uint8_t count = (c & 0x7F) + 1;
+    uint16_t from = 0;
+
+    if (c & 0x80)
+    {
+      count += COMPRESSIONMINMATCH - 1;
+      from = address + n - (src[0] + (src[1] << 8));
+      src += 2;
+    }
+
+    while (count--)
+    {
+      uint8_t b;
+
+      if (!(c & 0x80)) b = *src++;                                      // literal
+      else if (from >= address) b = PageBuffer[(uint8_t)(from - address)]; // current page
+      else b = pgm_read_byte (from);                                    // already programmed
+      from++;
+
+      PageBuffer[n++] = b;
+      if (n == PAGESIZE)
+      {
+        if (address < BOOTLOADER_ADDRESS) // prevent bootloader form self killing
+        {
+          boot_program_page (address, PageBuffer);
+          TOGGLELED;
+        }
+        address += PAGESIZE;
+        n = 0;
+      }
+    }
+  }
+}
+#endif
+
+#ifdef USE_MULTIPAGE
+//***************************************************************************************
+//  uint8_t receivePages()
+//
+//  Receive and program the pages of a multi page frame. A page block is received
+//  into FrameData[CRCLOW..] and has the same layout as the end of a normal frame.
+//  The generator sends 0 bits before each block while the last page is programmed.
+//
+//  output:    true: all pages received with correct checksum
+//
+//***************************************************************************************
+uint8_t receivePages()
+{
+  uint16_t pageNumber = (((uint16_t)FrameData[PAGEINDEXHIGH]) << 8) + FrameData[PAGEINDEXLOW];
+  uint16_t length = (((uint16_t)FrameData[LENGTHHIGH]) << 8) + FrameData[LENGTHLOW];
+  uint16_t address = SPM_PAGESIZE * pageNumber;
+
+  for (; length >= PAGESIZE; length -= PAGESIZE)
+  {
+    if (!receiveBlock(CRCLOW, PAGESIZE + DATAPAGESTART)) return false;
+
+    if (address < BOOTLOADER_ADDRESS) // prevent bootloader form self killing
+    {
+      boot_program_page (address, FrameData + DATAPAGESTART);
+      TOGGLELED;
+    }
+    address += PAGESIZE;
+  }
+  return true;
 }
+#endif
 
 inline void resetRegister()
 {
     DDRB = 0;
     cli();
     TCCR0B = 0; // turn off timer1
+#if defined(USE_FASTSTART) || defined(USE_SLEEP)
+    PCMSK = 0;
+    GIFR = (1 << PCIF);
+#endif
+#ifdef USE_SLEEP
+    GIMSK = 0;
+    WDTCR = (1 << WDCE) | (1 << WDE);
+    WDTCR = (1 << WDIF); // watchdog off
+#endif
+#ifdef USE_TIMER1
+    TCCR1 = 0;
+    PLLCSR &= ~(1 << PCKE);
+#endif
 	ADCSRA = 0;
 	ADMUX=0;
 }
@@ -531,13 +1250,19 @@ inline void resetRegister()
 void startMainApplication()
 {
 	resetRegister();
-	(*start_appl_main) ();
+	STARTAPPLICATION
 	
 }
 
 // use this routine on bootloader timeout and no flash values are written
 void exitBootloader()
 {  
+#ifdef USE_EEPROMQUEUE
+  eepromFlush();
+#endif
+#ifdef USE_RESUME
+  if (resumeId() != 0xFFFF) return; // an interrupted session: the application is incomplete
+#endif
   memcpy_P (&start_appl_main, (PGM_P) BOOTLOADER_FUNC_ADDRESS, sizeof (start_appl_main));
 
   if (start_appl_main)
@@ -549,6 +1274,19 @@ void exitBootloader()
 // use this routine after new flash values are written
 void runProgramm(void)
 {
+#ifdef USE_EEPROMQUEUE
+  eepromFlush();
+#endif
+#ifdef USE_RESUME
+  // page 0 may have been written in an earlier session
+  if (ResumeActive) start_appl_main = (void (*)(void))(uintptr_t)(ResumeVector - RJMP);
+  if (resumeId() != 0xFFFF)
+  {
+    eeprom_write(RESUMESTATE, 0xFF);
+    eeprom_write(RESUMESTATE + 1, 0xFF);
+    eeprom_busy_wait();
+  }
+#endif
   pgm_write_block (BOOTLOADER_FUNC_ADDRESS, (uint16_t *) &start_appl_main, sizeof (start_appl_main));
 
   startMainApplication();
@@ -641,6 +1379,18 @@ inline void initADC()
 
 }
 
+#ifdef USE_ADC_SLICER
+// free running ADC ( prescaler 16, 13us per conversion ), the switching levels
+// close to the bias of VCC/2 are used until the first preamble is measured
+inline void initSlicer()
+{
+  initADC();
+  ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADPS2);
+  SliceLow = 128 - SLICERMINSWING / 4;
+  SliceHigh = 128 + SLICERMINSWING / 4;
+}
+#endif
+
 inline void disableADC()
 {
 	  ADCSRA &=	 ~ (1 << ADEN) ;    // disable ADC
@@ -658,7 +1408,7 @@ inline void checkBootloaderSkip()
 
   if(SKIPPERPINVALUE==0) exitBootloader();
 
-#else#
+#else
   initADC();
 
   ADCSRA |= (1 << ADSC);         // start ADC measurement
@@ -670,13 +1420,121 @@ inline void checkBootloaderSkip()
 #endif
 }
 
+#ifdef USE_FASTSTART
+//***************************************************************************************
+// fastStart()
+//
+// The pin change flag catches the edges of the audio pin while timer 0 counts the
+// window in steps of 1ms. A quiet line starts the application after the window,
+// FASTSTARTEDGES pin changes start the bootloader at once.
+//***************************************************************************************
+inline void fastStart()
+{
+  uint8_t window = eeprom_read_byte((uint8_t *)FASTSTARTCONFIG);
+  uint8_t edges = FASTSTARTEDGES;
+  uint8_t ticks = 8;
+
+  if (window == 0)
+  {
+    checkBootloaderSkip();
+    return;
+  }
+  if (window == 0xFF) window = FASTSTARTWINDOW;
+
+  TCCR0B = _BV(CS01); // clk/8 ==> 2MHz
+  PCMSK = INPUTAUDIOPIN;
+  GIFR = (1 << PCIF);
+  while (1)
+  {
+    if (GIFR & (1 << PCIF))
+    {
+      GIFR = (1 << PCIF);
+      if (--edges == 0) break; // signal: start the bootloader
+    }
+    if (TCNT0 >= 250) // 125us
+    {
+      TCNT0 = 0;
+      if (--ticks == 0)
+      {
+        ticks = 8;
+        if (--window == 0)
+        {
+          exitBootloader();
+          break; // no application: wait for a signal
+        }
+      }
+    }
+  }
+  PCMSK = 0;
+}
+#endif
+
+#ifdef USE_SLEEP
+//***************************************************************************************
+// sleepUntilSignal()
+//
+// The interrupts stay disabled because the vector table belongs to the application.
+// An enabled interrupt source wakes up the CPU anyway, it goes on after the sleep
+// instruction without calling a handler. The flags are polled and cleared here.
+// The watchdog counts the blink periods of 0.5s for the LED and the timeout.
+// Only the first edge is waited for asleep, the wake-up time is paid once. Edges
+// which are not followed by the rest of the signal within a blink period are noise.
+//***************************************************************************************
+#define WDTBLINK ((1 << WDIF) | (1 << WDIE) | (1 << WDP2) | (1 << WDP0)) // 0.5s
+
+inline void sleepUntilSignal()
+{
+  uint8_t timeout = BOOT_TIMEOUT;
+  uint8_t exitcounter = 3;
+
+  PCMSK = INPUTAUDIOPIN;
+  GIFR = (1 << PCIF);
+  GIMSK = (1 << PCIE);
+  WDTCR = (1 << WDCE) | (1 << WDE);
+  WDTCR = WDTBLINK;
+  set_sleep_mode(SLEEPMODE);
+  sleep_enable();
+  while (exitcounter)
+  {
+    if (exitcounter == 3) sleep_cpu();
+    if (GIFR & (1 << PCIF))
+    {
+      GIFR = (1 << PCIF);
+      exitcounter--;
+    }
+    if (WDTCR & (1 << WDIF))
+    {
+      WDTCR = WDTBLINK;
+      TOGGLELED;
+      exitcounter = 3;
+      timeout--;
+      if (timeout == 0)
+      {
+        LEDOFF; // timeout,
+        // leave bootloader and run program
+        exitBootloader();
+      }
+    }
+  }
+  sleep_disable();
+  GIMSK = 0;
+  PCMSK = 0;
+  WDTCR = (1 << WDCE) | (1 << WDE);
+  WDTCR = (1 << WDIF); // watchdog off
+}
+#endif
+
 //***************************************************************************************
 // main loop
 //***************************************************************************************
-static inline void a_main()
+static inline void __attribute__((noreturn)) a_main()
 {
-  uint8_t p;
   uint16_t time = WAITBLINKTIME;
+
+#ifdef USE_SLEEP
+  sleepUntilSignal();
+#else
+  uint8_t p;
   uint8_t timeout = BOOT_TIMEOUT;
 
   p = PINVALUE;
@@ -686,7 +1544,7 @@ static inline void a_main()
   while (1)
   {
 
-    if (TIMER > 100) // timedelay ==> frequency @16MHz= 16MHz/8/100=20kHz
+    if (TIMER > 100 * TIMERSCALE) // timedelay ==> frequency @16MHz= 16MHz/8/100=20kHz
     {
       TIMER = 0;
       time--;
@@ -711,17 +1569,27 @@ static inline void a_main()
     }
     if (exitcounter == 0) break; // signal received, leave this loop and go on
   }
+#endif
   //*************** start command interpreter *************************************
   LEDON;
   while (1)
   {
-    if (!receiveFrame())
+    uint8_t frameOk = receiveFrame();
+
+#ifdef USE_MULTIPAGE
+    if (frameOk && FrameData[COMMAND] == MULTIPAGECOMMAND) frameOk = receivePages();
+#endif
+    SIMFRAME(frameOk)
+    if (!frameOk)
     {
       //*****  if data transfer error: blink fast, press reset to restart *******************
+#ifdef USE_EEPROMQUEUE
+      eepromFlush(); // the bytes of the last frame were checked
+#endif
 
       while (1)
       {
-        if (TIMER > 100) // timerstop ==> frequency @16MHz= 16MHz/8/100=20kHz
+        if (TIMER > 100 * TIMERSCALE) // timerstop ==> frequency @16MHz= 16MHz/8/100=20kHz
         {
           TIMER = 0;
           time--;
@@ -751,41 +1619,86 @@ static inline void a_main()
         }
         break;
 
+#ifdef USE_COMPRESSION
+        case COMPRESSEDCOMMAND:
+        {
+            uint16_t pageNumber = (((uint16_t)FrameData[PAGEINDEXHIGH]) << 8) + FrameData[PAGEINDEXLOW];
+
+            if (FrameData[LENGTHLOW] <= PAGESIZE)
+              decompressPages (SPM_PAGESIZE * pageNumber, FrameData + DATAPAGESTART, FrameData[LENGTHLOW]);
+        }
+        break;
+#endif
+
+#ifdef USE_ADC_SYMBOLS
+        case SYMBOLMODECOMMAND:
+        {
+            // the ADC clock of 1MHz ( prescaler 16 ) is out of the specified range but
+            // 8 bit results are good enough to distinguish the levels
+            initADC();
+            ADCSRA = (1 << ADEN) | (1 << ADPS2);
+            SymbolMode = true;
+        }
+        break;
+#endif
+
         case RUNCOMMAND:
         {
+#ifdef USE_RESUME
+            // pages missing: go on listening, the missing chapters can be played again
+            if (ResumeActive && !resumeComplete()) break;
+#endif
             // after programming leave bootloader and run program
             runProgramm();
         }
         break;
 
-        // case EXITCOMMAND:
-        // {
-        //     // after programming leave bootloader and run program
-        //     exitBootloader();
-        // }
-        // break;
+#ifdef USE_RESUME
+        case IMAGECOMMAND:
+        {
+            resumeImage((((uint16_t)FrameData[PAGEINDEXHIGH]) << 8) + FrameData[PAGEINDEXLOW],
+                        (((uint16_t)FrameData[LENGTHHIGH]) << 8) + FrameData[LENGTHLOW],
+                        FrameData + DATAPAGESTART);
+        }
+        break;
+#endif
+
+        case EXITCOMMAND:
+        {
+            // only EEPROM data was sent: leave bootloader and run the unchanged program
+            exitBootloader();
+        }
+        break;
 
+        // LENGTHLOW bytes from the EEPROM address PAGESIZE*page, the wav file sends
+        // as many frames as needed for the 512 bytes and ends with RUNCOMMAND or EXITCOMMAND
         case EEPROMCOMMAND:
         {
-            uint8_t pageNumber = FrameData[PAGEINDEXLOW];
+            uint16_t address = SPM_PAGESIZE * FrameData[PAGEINDEXLOW];
             uint8_t data_length = FrameData[LENGTHLOW];
-            uint8_t address = SPM_PAGESIZE * pageNumber;
-
             uint8_t *buf = FrameData + DATAPAGESTART;
-            
+
+            if (data_length > PAGESIZE) data_length = PAGESIZE;
+#ifdef USE_EEPROMQUEUE
+            // the bytes of the last frame are written first, these ones while the next frame arrives
+            eepromFlush();
+            for (uint8_t i = 0; i < data_length; i++) EepromQueue[i] = buf[i];
+            EepromQueueAddress = address;
+            EepromQueueIndex = 0;
+            EepromQueueLength = data_length;
+#else
             for (uint8_t i = 0; i < data_length; i++)
             {
-              //write received data to EEPROM
-              uint8_t w = *buf++;
-              eeprom_write(address + i, w);
+#ifdef USE_SKIPUNCHANGED
+              // an EEPROM write takes 3.4ms, unchanged bytes are skipped
+              if (eeprom_read_byte((uint8_t *)(uintptr_t)address) != *buf)
+#endif
+              eeprom_write(address, *buf);
+              address++;
+              buf++;
             }
-
-            //Leave bootloader after eeprom signal received
-            //todo: wait until all data sent > spm pagesize (64)
-            //fix this!!!!
-            LEDOFF;
-            exitBootloader();
-
+#endif
+            TOGGLELED;
         }
         break;
       }
@@ -798,14 +1711,30 @@ int main()
 {
   INITAUDIOPORT;
   
+#ifdef USE_FASTSTART
+  fastStart();
+#else
   checkBootloaderSkip();
+#endif
+#ifdef USE_ADC_SLICER
+  initSlicer();
+#endif
 	
   INITDEBUGPIN
   INITLED;
 
+#ifdef USE_TIMER1
+  // Timer 1 normal mode, PLL clock 64MHz/4, count up from 0 to 255
+  // ==> 16MHz, extended to 16 bit by timer1()
+  PLLCSR = (1 << PLLE);
+  while (!(PLLCSR & (1 << PLOCK)));
+  PLLCSR |= (1 << PCKE);
+  TCCR1 = (1 << CS11) | (1 << CS10);
+#else
   // Timer 2 normal mode, clk/8, count up from 0 to 255
   // ==> frequency @16MHz= 16MHz/8/256=7812.5Hz
   TCCR0B = _BV(CS01);
+#endif
 
   a_main(); // start the main function
 }
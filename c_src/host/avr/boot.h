@@ -0,0 +1,18 @@
+/*
+  mock <avr/boot.h> for the host simulation ( see hostsim.h )
+
+  The Attiny85 has no read-while-write section: the CPU is halted while
+  a page is erased or written, the simulated clock advances accordingly.
+*/
+#ifndef SIM_AVR_BOOT_H
+#define SIM_AVR_BOOT_H
+
+#include <avr/io.h>
+
+#define boot_page_fill(address, data) sim_page_fill((uint32_t)(address), (uint16_t)(data))
+#define boot_page_erase(address)      sim_page_erase((uint32_t)(address))
+#define boot_page_write(address)      sim_page_write((uint32_t)(address))
+#define boot_spm_busy_wait()          do { } while (0)
+#define boot_rww_enable()             do { } while (0)
+
+#endif
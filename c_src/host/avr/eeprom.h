@@ -0,0 +1,18 @@
+/*
+  mock <avr/eeprom.h> for the host simulation ( see hostsim.h )
+*/
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <avr/io.h>
+
+#define eeprom_is_ready()   (!(EECR & (1 << EEPE)))
+#define eeprom_busy_wait()  do { } while (!eeprom_is_ready())
+
+static inline uint8_t eeprom_read_byte(const uint8_t *address)
+{
+  eeprom_busy_wait();
+  return sim.eeprom[(uintptr_t)address % SIM_EEPROMSIZE];
+}
+
+#endif
@@ -0,0 +1,12 @@
+/*
+  mock <avr/interrupt.h> for the host simulation ( see hostsim.h )
+*/
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define cli() do { SREG &= 0x7F; } while (0)
+#define sei() do { SREG |= 0x80; } while (0)
+
+#endif
@@ -0,0 +1,120 @@
+/*
+  mock <avr/io.h> for the host simulation of the Attiny85 ( see hostsim.h )
+*/
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+#include "../hostsim.h"
+
+#define _BV(bit) (1 << (bit))
+
+// registers with side effects: every access advances the simulated clock
+#define PINB      (*sim_io(SIM_PINB))
+#define TCNT0     (*sim_io(SIM_TCNT0))
+#define TCNT1     (*sim_io(SIM_TCNT1))
+#define PLLCSR    (*sim_io(SIM_PLLCSR))
+#define EECR      (*sim_io(SIM_EECR))
+#define ADCSRA    (*sim_io(SIM_ADCSRA))
+#define ADCH      (*sim_io(SIM_ADCH))
+#define ADCL      (*sim_io(SIM_ADCL))
+#define GIFR      (*sim_io(SIM_GIFR))
+#define WDTCR     (*sim_io(SIM_WDTCR))
+
+// port B
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+
+// MCUCR
+#define SM0   3
+#define SM1   4
+#define SE    5
+
+// GIMSK
+#define PCIE  5
+#define INT0  6
+
+// GIFR
+#define PCIF  5
+#define INTF0 6
+
+// PCMSK
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+
+// WDTCR
+#define WDP0  0
+#define WDP1  1
+#define WDP2  2
+#define WDE   3
+#define WDCE  4
+#define WDP3  5
+#define WDIE  6
+#define WDIF  7
+
+// TCCR0B
+#define CS00 0
+#define CS01 1
+#define CS02 2
+
+// TCCR1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define CS13 3
+
+// PLLCSR
+#define PLOCK 0
+#define PLLE  1
+#define PCKE  2
+#define LSM   7
+
+// EECR
+#define EERE  0
+#define EEPE  1
+#define EEMPE 2
+#define EERIE 3
+#define EEPM0 4
+#define EEPM1 5
+
+// ADMUX
+#define MUX0  0
+#define MUX1  1
+#define MUX2  2
+#define MUX3  3
+#define REFS2 4
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+
+// ADCSRA
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE  3
+#define ADIF  4
+#define ADATE 5
+#define ADSC  6
+#define ADEN  7
+
+// SPMCSR
+#define SPMEN 0
+#define PGERS 1
+#define PGWRT 2
+#define RFLB  3
+#define CTPB  4
+
+#define SPM_PAGESIZE SIM_PAGESIZE
+#define E2END        (SIM_EEPROMSIZE - 1)
+#define FLASHEND     (SIM_FLASHSIZE - 1)
+#define RAMEND       0x25F
+
+#endif
@@ -0,0 +1,18 @@
+/*
+  mock <avr/pgmspace.h> for the host simulation ( see hostsim.h )
+
+  Program memory addresses are offsets into the emulated flash array.
+*/
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <avr/io.h>
+
+#define PROGMEM
+#define PGM_P uintptr_t
+
+#define pgm_read_byte(address)           sim_flash_read_byte((uint32_t)(address))
+#define pgm_read_word(address)           sim_flash_read_word((uint32_t)(address))
+#define memcpy_P(dest, address, n)       sim_flash_read((dest), (uint32_t)(address), (n))
+
+#endif
@@ -0,0 +1,18 @@
+/*
+  mock <avr/sleep.h> for the host simulation ( see hostsim.h )
+*/
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_ADC      (1 << SM0)
+#define SLEEP_MODE_PWR_DOWN (1 << SM1)
+
+#define set_sleep_mode(mode) do { MCUCR = (MCUCR & ~((1 << SM1) | (1 << SM0))) | (mode); } while (0)
+#define sleep_enable()       do { MCUCR |= (1 << SE); } while (0)
+#define sleep_disable()      do { MCUCR &= ~(1 << SE); } while (0)
+#define sleep_cpu()          sim_sleep()
+
+#endif
@@ -0,0 +1,318 @@
+/*
+  channelsim.cpp - bit error rate sweeps over the generator settings and the audio channel
+
+  usage: channelsim [options]
+
+  Random pages are encoded like hex2wav ( encoder.h ), passed through the
+  impairments of a playback device and the input circuit and decoded with
+  the rules of the bootloader ( demod.h ):
+
+    volume -> resampling to the device rate with clock drift and jitter
+           -> additive noise -> input high pass -> switching level and hysteresis
+
+  Every combination of the comma separated lists of -r, -b, -p, -g and -n is one
+  point of the sweep, the points run in parallel on all cores. For every point the
+  bit error rate of the received frames, the frame failure rate ( pages not
+  programmed ) and the worst margin of the sample point are reported. A generator
+  setting ( sample rate, bit rate, pre-emphasis ) is acceptable if all its points
+  stay within -e and -m, the fastest acceptable one is recommended.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include "encoder.h"
+#include "demod.h"
+#include "wavio.h"
+
+struct Channel
+{
+  double deviceRate = 48000;  // sample rate of the playback device, 0: the rate of the wav
+  double drift      = 0;      // ppm, the device plays faster
+  double jitter     = 0;      // rms in seconds
+  double highPass   = 500e-6; // time constant of the input network in seconds, 0: DC coupled
+  double threshold  = 0.5;
+  double hysteresis = 0.0;
+  bool   timer1     = false;
+  bool   fec        = false;
+  bool   shortSync  = false;
+};
+
+struct Point
+{
+  int    sampleRate;
+  double bitRate;
+  double preEmphasis;   // seconds
+  double gain;
+  double noise;         // rms in fractions of the full scale
+
+  // results
+  uint32_t bits      = 0;
+  uint32_t bitErrors = 0;
+  uint32_t pages     = 0;
+  uint32_t delivered = 0;
+  double   margin    = 0;
+  double   airtime   = 0;
+  bool     overflow  = false;
+};
+
+//***************************************************************************************
+// playback device: linear interpolation of the wav samples at the time of each device sample
+//***************************************************************************************
+static std::vector<float> play(const Signal &signal, int sampleRate, const Channel &channel,
+                               double gain, double noise, std::mt19937 &random)
+{
+  double rate = channel.deviceRate > 0 ? channel.deviceRate : sampleRate;
+  double step = sampleRate / rate * (1 + channel.drift * 1e-6);
+  std::normal_distribution<double> gauss(0, 1);
+  std::vector<float> out;
+
+  out.reserve((size_t)(signal.size() / step) + 1);
+  for (size_t k = 0;; k++)
+  {
+    double position = k * step;
+    if (channel.jitter > 0) position += gauss(random) * channel.jitter * sampleRate;
+    if (position < 0) position = 0;
+    size_t n = (size_t)position;
+    if (n + 1 >= signal.size()) break;
+
+    double value = signal[n] + (position - n) * (signal[n + 1] - signal[n]);
+    value *= gain;
+    if (noise > 0) value += gauss(random) * noise;
+    out.push_back((float)value);
+  }
+  if (channel.highPass > 0) highPass(out.data(), out.size(), (uint32_t)rate, channel.highPass);
+  return out;
+}
+
+// the frames as sent by the generator: header and data of each page
+static Bytes sentFrame(const Bytes &data, int page)
+{
+  Bytes frame(DATAPAGESTART + PAGESIZE, 0xFF);
+
+  frame[COMMAND]       = PROGCOMMAND;
+  frame[PAGEINDEXLOW]  = page & 0xFF;
+  frame[PAGEINDEXHIGH] = page >> 8;
+  frame[LENGTHLOW]     = data.size() & 0xFF;
+  frame[LENGTHHIGH]    = data.size() >> 8;
+  for (int n = 0; n < PAGESIZE; n++) frame[DATAPAGESTART + n] = data[page * PAGESIZE + n];
+  uint16_t crc = frameCrc(frame.data(), frame.size());
+  frame[CRCLOW]  = crc & 0xFF;
+  frame[CRCHIGH] = crc >> 8;
+  return frame;
+}
+
+static uint32_t bitErrors(const Bytes &sent, const uint8_t *received)
+{
+  uint32_t errors = 0;
+
+  for (size_t n = 0; n < sent.size(); n++) errors += __builtin_popcount(sent[n] ^ received[n]);
+  return errors;
+}
+
+static void runPoint(Point &p, const Channel &channel, int pages, unsigned seed)
+{
+  std::mt19937 random(seed);
+  Bytes data(pages * PAGESIZE);
+  Generator generator;
+  std::vector<Bytes> sent;
+  std::vector<bool> done(pages, false);
+  demod_t e;
+  frame_t f;
+  uint16_t crc;
+  int expected = 0, result;
+
+  for (uint8_t &b : data) b = random();
+  for (int n = 0; n < pages; n++) sent.push_back(sentFrame(data, n));
+
+  generator.sampleRate = p.sampleRate;
+  generator.bitRate = p.bitRate;
+  generator.fec = channel.fec;
+  generator.preEmphasisTime = p.preEmphasis;
+  generator.shortSync = channel.shortSync;
+  std::vector<float> samples = play(generator.generate(data, std::vector<int>()), p.sampleRate, channel, p.gain, p.noise, random);
+
+  demodInit(&e);
+  if (channel.timer1) { e.tickRate = 16e6; e.timerMask = 0xFFFF; }
+  if (channel.fec) e.fecSize = FECLANES + 1;
+  e.shortSync = channel.shortSync;
+  demodEdges(&e, samples.data(), samples.size(), channel.deviceRate > 0 ? (uint32_t)channel.deviceRate : p.sampleRate,
+             1.0, channel.threshold, channel.hysteresis);
+
+  p.pages = pages;
+  p.margin = 1;
+  while ((result = demodFrame(&e, &f, &crc)) >= 0)
+  {
+    int page = f.data[PAGEINDEXLOW] | (f.data[PAGEINDEXHIGH] << 8);
+
+    if (f.data[COMMAND] == RUNCOMMAND && result) break;
+    if (expected >= pages) continue;
+
+    // the sent frame: the page index if it fits better than the next page in sequence
+    if (page >= pages || bitErrors(sent[page], f.data) > bitErrors(sent[expected], f.data)) page = expected;
+    p.bits += sent[page].size() * 8;
+    p.bitErrors += bitErrors(sent[page], f.data);
+    if (result && !memcmp(sent[page].data(), f.data, sent[page].size())) done[page] = true;
+    if (f.minMargin < p.margin) p.margin = f.minMargin;
+    p.airtime = f.end;
+    expected = page + 1;
+  }
+  for (bool d : done) p.delivered += d;
+  p.overflow = e.overflow;
+  demodFree(&e);
+}
+
+static std::vector<double> list(const char *s)
+{
+  std::vector<double> values;
+
+  while (*s)
+  {
+    char *end;
+    values.push_back(strtod(s, &end));
+    if (end == s) break;
+    s = *end == ',' ? end + 1 : end;
+  }
+  return values;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: channelsim [options]\n"
+          "  generator settings, comma separated lists:\n"
+          "  -r rates     sample rates of the wav ( default 44100 )\n"
+          "  -b rates     bit rates in bit/s ( default 5512.5,8820,11025,14700,22050 )\n"
+          "  -p us        pre-emphasis time constants, 0: off ( default 0 )\n"
+          "  channel, comma separated lists:\n"
+          "  -g gains     volume ( default 1 )\n"
+          "  -n levels    rms noise in fractions of the full scale ( default 0 )\n"
+          "  channel:\n"
+          "  -o rate      sample rate of the playback device, 0: no resampling ( default 48000 )\n"
+          "  -d ppm       clock drift of the playback device ( default 0 )\n"
+          "  -j ns        rms jitter of the playback clock ( default 0 )\n"
+          "  -H us        time constant of the input high pass, 0: DC coupled ( default 500 )\n"
+          "  -t threshold switching level in fractions of VCC ( default 0.5 )\n"
+          "  -y width     hysteresis in fractions of VCC ( default 0 )\n"
+          "  receiver:\n"
+          "  -T           16 bit timer at 16MHz ( USE_TIMER1 )\n"
+          "  -F           frames with FEC bytes ( USE_FEC ), no correction\n"
+          "  -S           full preamble only on the first frame ( USE_SHORTSYNC )\n"
+          "  sweep:\n"
+          "  -f pages     random pages per point ( default 32 )\n"
+          "  -s seed      random data, noise and jitter ( default 1 )\n"
+          "  -J jobs      parallel jobs ( default: all cores )\n"
+          "  -e rate      acceptable frame failure rate ( default 0 )\n"
+          "  -m percent   smallest acceptable margin of the sample point ( default 10 )\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<double> rates = { 44100 }, bitRates = { 5512.5, 8820, 11025, 14700, 22050 };
+  std::vector<double> preEmphasis = { 0 }, gains = { 1 }, noises = { 0 };
+  Channel channel;
+  int pages = 32, jobs = std::thread::hardware_concurrency(), opt;
+  unsigned seed = 1;
+  double maxFailures = 0, minMargin = 0.10;
+
+  while ((opt = getopt(argc, argv, "r:b:p:g:n:o:d:j:H:t:y:TFSf:s:J:e:m:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'r': rates = list(optarg); break;
+      case 'b': bitRates = list(optarg); break;
+      case 'p': preEmphasis = list(optarg); for (double &t : preEmphasis) t *= 1e-6; break;
+      case 'g': gains = list(optarg); break;
+      case 'n': noises = list(optarg); break;
+      case 'o': channel.deviceRate = atof(optarg); break;
+      case 'd': channel.drift = atof(optarg); break;
+      case 'j': channel.jitter = atof(optarg) * 1e-9; break;
+      case 'H': channel.highPass = atof(optarg) * 1e-6; break;
+      case 't': channel.threshold = atof(optarg); break;
+      case 'y': channel.hysteresis = atof(optarg); break;
+      case 'T': channel.timer1 = true; break;
+      case 'F': channel.fec = true; break;
+      case 'S': channel.shortSync = true; break;
+      case 'f': pages = atoi(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      case 'J': jobs = atoi(optarg); break;
+      case 'e': maxFailures = atof(optarg); break;
+      case 'm': minMargin = atof(optarg) / 100; break;
+      default: usage();
+    }
+  }
+  if (optind != argc || pages < 1) usage();
+  if (jobs < 1) jobs = 1;
+
+  std::vector<Point> points;
+  for (double r : rates)
+    for (double b : bitRates)
+      for (double pe : preEmphasis)
+        for (double g : gains)
+          for (double n : noises)
+          {
+            Point p;
+            p.sampleRate = (int)r;
+            p.bitRate = b;
+            p.preEmphasis = pe;
+            p.gain = g;
+            p.noise = n;
+            if (r / b >= 2) points.push_back(p);
+          }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (int j = 0; j < jobs; j++)
+  {
+    threads.emplace_back([&]() {
+      for (size_t i; (i = next++) < points.size();) runPoint(points[i], channel, pages, seed);
+    });
+  }
+  for (std::thread &t : threads) t.join();
+
+  printf("# device %.0f Hz, drift %.0f ppm, jitter %.0f ns, high pass %.0f us, threshold %.2f, hysteresis %.2f, %s, %d pages per point\n",
+         channel.deviceRate, channel.drift, channel.jitter * 1e9, channel.highPass * 1e6, channel.threshold,
+         channel.hysteresis, channel.timer1 ? "Timer1" : "timer 0", pages);
+  printf("# rate    bit/s  pre/us  gain   noise      BER       FER  margin  payload bit/s\n");
+
+  const Point *best = NULL;
+  for (size_t i = 0; i < points.size();)
+  {
+    // all points of one generator setting
+    size_t end = i;
+    bool acceptable = true;
+
+    while (end < points.size() && points[end].sampleRate == points[i].sampleRate &&
+           points[end].bitRate == points[i].bitRate && points[end].preEmphasis == points[i].preEmphasis)
+    {
+      const Point &p = points[end++];
+      double ber = p.bits ? (double)p.bitErrors / p.bits : 1;
+      double fer = 1 - (double)p.delivered / p.pages;
+
+      printf("%6d %8.1f %7.0f %5.2f %7.3f %9.2e %8.4f %6.0f%% %14.0f%s\n", p.sampleRate, p.bitRate, p.preEmphasis * 1e6,
+             p.gain, p.noise, ber, fer, p.bits ? 100 * p.margin : 0, p.airtime > 0 ? p.delivered * PAGESIZE * 8 / p.airtime : 0,
+             p.overflow ? "  timer overflow" : "");
+      if (fer > maxFailures || !p.bits || p.margin < minMargin) acceptable = false;
+    }
+    if (acceptable && (!best || points[i].bitRate > best->bitRate)) best = &points[i];
+    i = end;
+  }
+
+  if (best)
+    printf("# fastest acceptable setting: %.1f bit/s at %d Hz, pre-emphasis %.0f us\n",
+           best->bitRate, best->sampleRate, best->preEmphasis * 1e6);
+  else
+    printf("# no setting with a frame failure rate up to %g and a margin of %.0f%%\n", maxFailures, 100 * minMargin);
+  return best ? 0 : 1;
+}
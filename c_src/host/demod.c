@@ -0,0 +1,199 @@
+/*
+  demod.c - receiver of the host tools, see demod.h
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+#include "AudioBootFrame.h"
+#include "demod.h"
+
+// timer 0 at F_CPU/8 like the default build
+void demodInit(demod_t *e)
+{
+  memset(e, 0, sizeof(*e));
+  e->tickRate = F_CPU / 8.0;
+  e->timerMask = 0xFF;
+}
+
+void demodFree(demod_t *e)
+{
+  free(e->time);
+  free(e->level);
+  e->time = NULL;
+  e->level = NULL;
+}
+
+//***************************************************************************************
+// input pin: switching level and hysteresis in fractions of VCC, the bias is VCC/2
+// the crossings between two samples are interpolated like the output of a DAC
+//***************************************************************************************
+void demodEdges(demod_t *e, const float *samples, uint32_t numSamples, uint32_t sampleRate,
+                double gain, double threshold, double hysteresis)
+{
+  uint8_t pin = 0;
+  uint32_t n, capacity = 1024;
+
+  free(e->time);
+  free(e->level);
+  e->time = malloc(capacity * sizeof(double));
+  e->level = malloc(capacity);
+  e->count = e->next = 0;
+  e->now = 0;
+
+  for (n = 0; n + 1 < numSamples; n++)
+  {
+    double a = 0.5 + 0.5 * gain * samples[n];
+    double b = 0.5 + 0.5 * gain * samples[n + 1];
+    double level = pin ? threshold - hysteresis / 2 : threshold + hysteresis / 2;
+
+    if (pin ? (b < level) : (b > level))
+    {
+      if (e->count == capacity)
+      {
+        capacity *= 2;
+        e->time = realloc(e->time, capacity * sizeof(double));
+        e->level = realloc(e->level, capacity);
+      }
+      pin = !pin;
+      e->time[e->count] = (n + (a == b ? 1 : (level - a) / (b - a))) / sampleRate;
+      e->level[e->count++] = pin;
+    }
+  }
+}
+
+// pin level at the time t
+static uint8_t pinAt(const demod_t *e, double t)
+{
+  uint32_t n = e->next;
+
+  while (n < e->count && e->time[n] <= t) n++;
+  return n ? e->level[n - 1] : 0;
+}
+
+// wait for the next edge after the current time, false at the end of the signal
+static int waitEdge(demod_t *e)
+{
+  while (e->next < e->count && e->time[e->next] <= e->now) e->next++;
+  if (e->next == e->count) return 0;
+  e->now = e->time[e->next++];
+  return 1;
+}
+
+static uint32_t ticks(const demod_t *e, double seconds)
+{
+  return (uint32_t)(seconds * e->tickRate) & e->timerMask;
+}
+
+//***************************************************************************************
+// receiveBlock(): the bytes data[start..end-1] and the FEC bytes after the start bit
+//***************************************************************************************
+int demodBlock(demod_t *e, frame_t *f, uint8_t start, uint8_t end, uint16_t *crc)
+{
+  double delay = f->delayTime / e->tickRate;
+  uint8_t dataPointer = start, p, t, k = 8;
+  uint16_t n;
+
+  if (f->delayTime > e->timerMask)
+  {
+    e->overflow = 1;
+    return -1;
+  }
+
+  // start bit: an edge followed by a second one within the delay
+  do
+  {
+    if (!waitEdge(e)) return -1;
+    p = e->level[e->next - 1];
+    e->now += delay;
+  } while (p == pinAt(e, e->now));
+  p = pinAt(e, e->now);
+  if (start == 0) f->startBit = e->now;
+
+  *crc = 0xFFFF;
+  for (n = 0; n < (uint16_t)(end - start + e->fecSize) * 8; n++)
+  {
+    double middle, margin;
+
+    if (!waitEdge(e)) return -1;
+    middle = e->now;
+    p = e->level[e->next - 1];
+
+    if (k == 0)
+    {
+      if ((uint8_t)(dataPointer - CRCLOW) > 1 && dataPointer < end) *crc = frameCrcUpdate(*crc, f->data[dataPointer]);
+      dataPointer++;
+      k = 8;
+      // the header is complete: compressed frames are shorter, multi page frames continue with page blocks
+      if (dataPointer == CRCLOW && f->data[COMMAND] == COMPRESSEDCOMMAND && f->data[LENGTHLOW] < PAGESIZE) end = DATAPAGESTART + f->data[LENGTHLOW];
+      if (dataPointer == CRCLOW && f->data[COMMAND] == MULTIPAGECOMMAND) end = DATAPAGESTART;
+    }
+
+    e->now = middle + delay;
+    t = pinAt(e, e->now);
+    f->data[dataPointer] = f->data[dataPointer] << 1;
+    if (p != t) f->data[dataPointer] |= 1;
+
+    // distance of the sample point to the bit boundary edge ( 1 ) or the next middle edge ( 0 )
+    if (e->next < e->count)
+    {
+      margin = p != t ? e->now - e->time[e->next] : e->time[e->next] - e->now;
+      margin /= f->bitTime;
+      if (margin < f->minMargin) f->minMargin = margin;
+    }
+    p = t;
+    k--;
+    f->bits++;
+  }
+  if ((uint8_t)(dataPointer - CRCLOW) > 1 && dataPointer < end) *crc = frameCrcUpdate(*crc, f->data[dataPointer]);
+  f->end = e->now;
+  return *crc == (uint16_t)(f->data[CRCLOW] | (f->data[CRCHIGH] << 8));
+}
+
+// receiveFrame(): synchronisation on the preamble and the first block
+int demodFrame(demod_t *e, frame_t *f, uint16_t *crc)
+{
+  uint16_t time = 0;
+  double edge[17];
+  uint8_t n;
+
+  memset(f, 0, sizeof(*f));
+  f->minMargin = 1;
+  if (!waitEdge(e)) return -1;
+  if (e->shortSync && e->delayTime)
+  {
+    // USE_SHORTSYNC: the bit time of the first frame, SHORTSYNCGUARD 0 bits in a row before the start bit
+    f->delayTime = e->delayTime;
+    f->bitTime = e->bitTime;
+    f->start = e->now;
+    for (n = 0; n < SHORTSYNCGUARD;)
+    {
+      uint8_t p = e->level[e->next - 1];
+
+      e->now += f->delayTime / e->tickRate;
+      n = p == pinAt(e, e->now) ? n + 1 : 0;
+      if (n < SHORTSYNCGUARD && !waitEdge(e)) return -1;
+    }
+    return demodBlock(e, f, 0, PAGESIZE + DATAPAGESTART, crc);
+  }
+  edge[0] = e->now;
+  for (n = 0; n < 16; n++)
+  {
+    if (!waitEdge(e)) return -1;
+    edge[n + 1] = e->now;
+    if (n >= 8) time += ticks(e, edge[n + 1] - edge[n]);
+  }
+  f->delayTime = time * 3 / 4 / 8;
+  f->bitTime = time / 8.0 / e->tickRate;
+  e->delayTime = f->delayTime;
+  e->bitTime = f->bitTime;
+
+  // the preamble starts after the last long interval, a single edge before it belongs to the gap
+  for (n = 16; n > 0 && edge[n] - edge[n - 1] < 2 * f->bitTime; n--);
+  f->start = edge[n];
+  return demodBlock(e, f, 0, PAGESIZE + DATAPAGESTART, crc);
+}
@@ -0,0 +1,74 @@
+/*
+  demod.h - receiver of the host tools ( wavdemod, channelsim )
+
+  The samples are turned into the edges of the digital input pin and the frames
+  are recovered with the rules of receiveFrame() and receiveBlock() in TinyAudioBoot.c,
+  see wavdemod.c. All state is in demod_t, so several receivers can run in parallel.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#ifndef DEMOD_H
+#define DEMOD_H
+
+#include <stdint.h>
+#include "hostsim.h"
+#include "AudioBootFrame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if SIM_PAGESIZE != PAGESIZE
+  #error "the simulated flash page has to hold the data of a frame"
+#endif
+
+#define DEMODFRAMESIZE (DATAPAGESTART + PAGESIZE + FECLANES + 1)
+
+typedef struct
+{
+  double   tickRate;    // timer ticks per second
+  uint32_t timerMask;   // 0xFF: timer 0, 0xFFFF: Timer1
+  uint8_t  fecSize;     // FEC bytes at the end of each block
+  uint8_t  overflow;    // the sample delay is longer than the timer range, the receiver hangs
+  uint8_t  shortSync;   // USE_SHORTSYNC: only the first frame is measured
+  uint16_t delayTime;   // sample delay and bit time of the last measurement
+  double   bitTime;
+
+  double  *time;        // edges of the input pin in seconds
+  uint8_t *level;       // pin level after the edge
+  uint32_t count;
+  uint32_t next;        // next edge to wait for
+  double   now;         // time of the receiver
+} demod_t;
+
+typedef struct
+{
+  uint8_t  data[DEMODFRAMESIZE];
+  uint16_t delayTime;   // sample delay in timer ticks
+  double   bitTime;     // seconds
+  double   minMargin;   // fractions of a bit time
+  double   start;       // first edge of the preamble
+  double   startBit;    // sample point of the start bit
+  double   end;         // sample point of the last bit
+  uint16_t bits;        // data bits received
+} frame_t;
+
+void demodInit(demod_t *e);
+void demodFree(demod_t *e);
+
+// input pin: switching level and hysteresis in fractions of VCC, the bias is VCC/2
+void demodEdges(demod_t *e, const float *samples, uint32_t numSamples, uint32_t sampleRate,
+                double gain, double threshold, double hysteresis);
+
+// -1 at the end of the signal, otherwise true if the checksum is correct
+int demodFrame(demod_t *e, frame_t *f, uint16_t *crc);
+int demodBlock(demod_t *e, frame_t *f, uint8_t start, uint8_t end, uint16_t *crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,605 @@
+/*
+  encoder.h - signal generator of the host tools ( hex2wav, channelsim )
+
+  The frame sequence and the differential manchester code of the Java generator
+  ( wavCreator/WavCodeGenerator.java and HexToSignal.java ), built with the frame
+  format of the bootloader ( AudioBootFrame.h ).
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "AudioBootFrame.h"
+
+static const int    EEPROMSIZE      = 512;
+static const double PROGRAMMINGTIME = 0.0095;  // page erase + page write + margin in seconds
+static const double EEPROMWRITETIME = 0.0035;  // EEPROM erase and write of one byte + margin in seconds
+static const double SILENCE         = 0.02;    // between the frames without gapless frames, in seconds
+static const int    RESUMESIZE      = 16;      // EEPROM bytes of the resume state, RESUMESIZE in TinyAudioBoot.c
+static const int    RESUMESTATE     = EEPROMSIZE - 32; // the bytes from here on belong to USE_RESUME
+static const int    FASTSTARTCONFIG = EEPROMSIZE - 1;  // start window of USE_FASTSTART in ms
+
+// first address from "from" on which the eep file sets, -1 if there is none
+static inline int eepromDataFrom(const std::vector<int> &eeprom, int from)
+{
+  for (int n = from; n < (int)eeprom.size(); n++)
+  {
+    if (eeprom[n] >= 0) return n;
+  }
+  return -1;
+}
+
+typedef std::vector<double>  Signal;
+typedef std::vector<uint8_t> Bytes;
+
+//***************************************************************************************
+// differential manchester code ( inverted ), see HexToSignal.java
+// an edge at the time t ( in samples ) is centered between the samples t-1 and t
+//***************************************************************************************
+class ManchesterEncoder
+{
+public:
+  // preEmphasisTime: time constant of the input high pass in samples, 0: off
+  ManchesterEncoder(double samplesPerBit, double preEmphasisTime = 0)
+    : samplesPerBit(samplesPerBit), preEmphasisTime(preEmphasisTime)
+  {
+    bandLimited = samplesPerBit / 2 != std::floor(samplesPerBit / 2);
+  }
+
+  // zeroBits 0 bits, the start bit and the frame bytes, MSB first
+  Signal code(const Bytes &frame, int zeroBits)
+  {
+    append(frame, zeroBits);
+    return end();
+  }
+
+  // as code(), the next call continues with the same phase ( blocks of a multi page frame )
+  void append(const Bytes &frame, int zeroBits)
+  {
+    for (int n = 0; n < zeroBits; n++) bit(false);
+    bit(true);
+    for (uint8_t b : frame)
+    {
+      for (int n = 7; n >= 0; n--) bit((b >> n) & 1);
+    }
+  }
+
+  // 4 level symbols, see HexToSignal.symbolCoding() and receiveSymbolFrame() in TinyAudioBoot.c
+  // full amplitude symbols for synchronisation, the lowest level as start symbol, the frame bytes MSB first
+  // invert: for an inverting input circuit
+  void appendSymbols(const Bytes &frame, int syncSymbols, bool invert = false)
+  {
+    for (int n = 0; n < syncSymbols; n++) symbol(3, invert);
+    symbol(0, invert);
+    for (uint8_t b : frame)
+    {
+      for (int n = 6; n >= 0; n -= 2) symbol((b >> n) & 3, invert);
+    }
+    symbols = true;
+  }
+
+  // the signal of all appended parts, the encoder starts again
+  Signal end()
+  {
+    Signal signal = render((int)std::ceil(position));
+    // the pre-emphasis would change the amplitude of the symbols
+    if (preEmphasisTime > 0 && !symbols) preEmphasis(signal);
+    symbols = false;
+    edges.clear();
+    phase = 1;
+    level = 0;
+    position = 0;
+    return signal;
+  }
+
+private:
+  static const int    STEPWIDTH      = 8;    // samples on each side of an edge
+  static const int    STEPRESOLUTION = 256;  // table entries per sample
+  static constexpr double CUTOFF     = 0.45; // low pass cutoff as fraction of the sample rate
+
+  struct Edge { double time, step; };
+
+  double samplesPerBit;
+  double preEmphasisTime;
+  bool bandLimited;
+  std::vector<Edge> edges;
+  double phase    = 1;
+  double level    = 0;  // after the last edge
+  double position = 0;  // start of the next bit in samples
+  bool symbols    = false;
+
+  void setLevel(double time, double value)
+  {
+    if (value == level) return;
+    edges.push_back({ time, value - level });
+    level = value;
+  }
+
+  void bit(bool one)
+  {
+    if (one) phase = -phase;
+    setLevel(position, phase);
+    phase = -phase;
+    setLevel(position + samplesPerBit / 2, phase);
+    position += samplesPerBit;
+  }
+
+  // first half positive, second half negative: no DC part, the input pin falls in the middle
+  void symbol(int n, bool invert)
+  {
+    double amplitude = (double)SYMBOLLEVEL(n) / SYMBOLLEVEL(3);
+
+    if (invert) amplitude = -amplitude;
+    setLevel(position, amplitude);
+    setLevel(position + samplesPerBit / 2, -amplitude);
+    position += samplesPerBit;
+  }
+
+  // integral of a Blackman windowed sinc low pass, from -STEPWIDTH to STEPWIDTH samples
+  static const std::vector<double> &stepTable()
+  {
+    static std::vector<double> table;
+
+    if (table.empty())
+    {
+      int length = 2 * STEPWIDTH * STEPRESOLUTION;
+      double sum = 0;
+
+      table.resize(length + 1);
+      for (int k = 0; k <= length; k++)
+      {
+        double x = (double)k / STEPRESOLUTION - STEPWIDTH;
+        double sinc = 1;
+        if (x != 0) sinc = std::sin(2 * M_PI * CUTOFF * x) / (2 * M_PI * CUTOFF * x);
+        double window = 0.42 + 0.5 * std::cos(M_PI * x / STEPWIDTH) + 0.08 * std::cos(2 * M_PI * x / STEPWIDTH);
+        sum += sinc * window;
+        table[k] = sum;
+      }
+      for (double &t : table) t /= sum;
+    }
+    return table;
+  }
+
+  Signal render(int length)
+  {
+    Signal signal(length);
+    double value = 0;
+    size_t k = 0;
+
+    for (int n = 0; n < length; n++)
+    {
+      while (k < edges.size() && edges[k].time < n + 0.5) value += edges[k++].step;
+      signal[n] = value;
+    }
+    if (!bandLimited) return signal;
+
+    const std::vector<double> &table = stepTable();
+    for (const Edge &e : edges)
+    {
+      double center = e.time - 0.5;
+      for (int n = std::max(0, (int)std::ceil(center - STEPWIDTH)); n < length && n < center + STEPWIDTH; n++)
+      {
+        double x = n - center;
+        signal[n] += e.step * (table[(int)std::floor((x + STEPWIDTH) * STEPRESOLUTION + 0.5)] - (x > 0 ? 1 : 0));
+      }
+    }
+    for (double &s : signal) s = std::max(-1.0, std::min(1.0, s));
+    return signal;
+  }
+
+  // x + integral(x)/tau boosts each edge against the droop of the input high pass, the integral leaks within 8 bits
+  void preEmphasis(Signal &signal) const
+  {
+    double leak = 1 - 1 / (8 * samplesPerBit);
+    double scale = 1 / (1 + samplesPerBit / preEmphasisTime);
+    double state = 0;
+
+    for (double &s : signal)
+    {
+      state = state * leak + s / preEmphasisTime;
+      s = std::max(-1.0, std::min(1.0, scale * (s + state)));
+    }
+  }
+};
+
+//***************************************************************************************
+// LZ compression of the flash image, see LzCompressor.java and decompressPages() in TinyAudioBoot.c
+// every page is compressed on its own, a match may refer to every byte of the image before
+//***************************************************************************************
+class LzCompressor
+{
+public:
+  static const int MAXMATCH    = 0x7F + COMPRESSIONMINMATCH;
+  static const int MAXLITERALS = 0x80;
+  static const int FIRSTSOURCE = 2;  // the reset vector is patched by the bootloader
+
+  // the data is padded with 0xFF to whole pages
+  LzCompressor(const Bytes &image) : data(image)
+  {
+    data.resize((image.size() + PAGESIZE - 1) / PAGESIZE * PAGESIZE, 0xFF);
+  }
+
+  /* greedy search for the longest match, the matches refer only to the pages from firstPage on:
+   * a resumed playback ( USE_RESUME ) starts at a chapter and the pages of the chapters
+   * before it may not be programmed yet
+   */
+  Bytes compressPage(int page, int firstPage = 0) const
+  {
+    int start = page * PAGESIZE, end = start + PAGESIZE;
+    int literals = start, pos = start;
+    int firstSource = std::max(FIRSTSOURCE, firstPage * PAGESIZE);
+    Bytes out;
+
+    while (pos < end)
+    {
+      int maxLength = std::min(MAXMATCH, end - pos);
+      int bestLength = 0, bestDistance = 0;
+
+      for (int src = pos - 1; src >= firstSource && bestLength < maxLength; src--)
+      {
+        int l = 0;
+        while (l < maxLength && data[src + l] == data[pos + l]) l++;
+        if (l > bestLength)
+        {
+          bestLength = l;
+          bestDistance = pos - src;
+        }
+      }
+
+      // a match of COMPRESSIONMINMATCH bytes is as long as the literals
+      if (bestLength > COMPRESSIONMINMATCH)
+      {
+        addLiterals(out, literals, pos);
+        out.push_back(0x80 | (bestLength - COMPRESSIONMINMATCH));
+        out.push_back(bestDistance & 0xFF);
+        out.push_back(bestDistance >> 8);
+        pos += bestLength;
+        literals = pos;
+      }
+      else pos++;
+    }
+    addLiterals(out, literals, end);
+    return out;
+  }
+
+private:
+  Bytes data;
+
+  void addLiterals(Bytes &out, int from, int to) const
+  {
+    while (from < to)
+    {
+      int n = std::min(MAXLITERALS, to - from);
+      out.push_back(n - 1);
+      out.insert(out.end(), data.begin() + from, data.begin() + from + n);
+      from += n;
+    }
+  }
+};
+
+//***************************************************************************************
+// frame sequence of WavCodeGenerator.writeSignal()
+//***************************************************************************************
+class Generator
+{
+public:
+  int    sampleRate  = 44100;
+  double bitRate     = 0;      // 0: full or half speed
+  bool   fullSpeed   = true;
+  bool   gapless     = true;
+  bool   fec         = false;
+  bool   compression = false;  // LZ compressed frames of several pages ( USE_COMPRESSION )
+  int    pagesPerFrame = 1;    // more than 1: multi page frames ( USE_MULTIPAGE )
+  int    blockGapBits = 4;     // 0 bits before each page block of a multi page frame
+  bool   symbolMode  = false;  // 4 level symbols after a SYMBOLMODECOMMAND frame ( USE_ADC_SYMBOLS ),
+                               // without FEC data, compression and multi page frames
+  bool   invertSymbols = false; // for an inverting input circuit
+  bool   eepromQueue = false;
+  double leadInTime  = 0;
+  double preEmphasisTime = 0; // seconds, C*(R1||R2) of the input network, 0: off
+  bool   shortSync   = false;  // only the first frame has the full preamble ( USE_SHORTSYNC )
+  int    chapterPages = 0;     // pages per chapter of a resumable session ( USE_RESUME ), 0: no chapters
+
+  struct Chapter { size_t position; int page; };  // sample position of the IMAGECOMMAND frame, first page
+  std::vector<Chapter> chapters;                  // of the last generated signal
+  size_t endFramePosition = 0;                    // sample position of its RUN or EXIT frame
+
+  double samplesPerBit() const
+  {
+    double rate = bitRate;
+    if (rate == 0) rate = fullSpeed ? 44100 / 4.0 : 44100 / 8.0;
+    return sampleRate / rate;
+  }
+
+  // eeprom: -1 for the bytes not in the eep file, empty: no EEPROM frames
+  Signal generate(const Bytes &data, const std::vector<int> &eeprom)
+  {
+    int pages = (data.size() + PAGESIZE - 1) / PAGESIZE;
+    bool compression = this->compression && !symbolMode;
+    int pagesPerFrame = symbolMode ? 1 : this->pagesPerFrame;
+    int nextChapter = 0;
+
+    signal.assign(1, 0.0);
+    preambleTime = leadInTime;
+    synchronised = false;
+    symbols = false;
+    pageIndex = 4;
+    totalLength = 0;
+    chapters.clear();
+    if (symbolMode)
+    {
+      sendFrame(SYMBOLMODECOMMAND, Bytes());
+      symbols = true;
+    }
+
+    std::vector<Bytes> compressedPages;
+    if (compression)
+    {
+      LzCompressor lz(data);
+      for (int page = 0; page < pages; page++)
+      {
+        compressedPages.push_back(lz.compressPage(page, chapterPages > 0 ? page / chapterPages * chapterPages : 0));
+      }
+    }
+
+    for (int page = 0; page < pages;)
+    {
+      int numPages = 1;
+      double pageTime = PROGRAMMINGTIME;
+      Bytes part;
+
+      if (chapterPages > 0 && page >= nextChapter)
+      {
+        chapters.push_back({ signal.size(), page });
+        sendImage(data);
+        nextChapter = page + chapterPages;
+      }
+      // the frames end at the chapter boundaries, so the chapters start at multiples of chapterPages
+      int lastPage = chapterPages > 0 ? std::min(pages, nextChapter) : pages;
+
+      if (compression)
+      {
+        // as many pages as fit into one frame
+        part = compressedPages[page];
+        while (page + numPages < lastPage && part.size() + compressedPages[page + numPages].size() < PAGESIZE)
+        {
+          part.insert(part.end(), compressedPages[page + numPages].begin(), compressedPages[page + numPages].end());
+          numPages++;
+        }
+      }
+
+      pageIndex = page;
+      if (pagesPerFrame > 1 && !(compression && part.size() < PAGESIZE))
+      {
+        numPages = std::min(pagesPerFrame, lastPage - page);
+        sendMultiPage(data, numPages);
+        // the last page is programmed after the frame
+        waitFor(pageProgrammingTime(), SILENCE);
+        page += numPages;
+        continue;
+      }
+      if (compression && part.size() < PAGESIZE)
+      {
+        totalLength = part.size();
+        sendFrame(COMPRESSEDCOMMAND, part);
+        pageTime = pageProgrammingTime();
+      }
+      else // uncompressed
+      {
+        numPages = 1;
+        part.assign(PAGESIZE, 0xFF);
+        for (int n = 0; n < PAGESIZE && page * PAGESIZE + n < (int)data.size(); n++) part[n] = data[page * PAGESIZE + n];
+        totalLength = data.size();
+        sendFrame(PROGCOMMAND, part);
+      }
+      // the bootloader erases and writes the pages after the frame has been received
+      waitFor(numPages * pageTime, numPages * SILENCE);
+      page += numPages;
+    }
+
+    for (int page = 0; page * PAGESIZE < (int)eeprom.size(); page++)
+    {
+      int length = 0;
+      for (int n = 0; n < PAGESIZE && page * PAGESIZE + n < (int)eeprom.size(); n++)
+      {
+        if (eeprom[page * PAGESIZE + n] >= 0) length = n + 1;
+      }
+      if (length == 0) continue;
+
+      Bytes part(length);
+      for (int n = 0; n < length; n++) part[n] = eeprom[page * PAGESIZE + n] < 0 ? 0xFF : eeprom[page * PAGESIZE + n];
+      pageIndex = page;
+      totalLength = length;
+      sendFrame(EEPROMCOMMAND, part);
+
+      double writeTime = length * EEPROMWRITETIME;
+      if (eepromQueue) writeTime = std::max(0.0, writeTime - frameDuration(EEPROMCOMMAND));
+      waitFor(writeTime, SILENCE + writeTime);
+    }
+
+    endFramePosition = signal.size();
+    sendFrame(pages > 0 ? RUNCOMMAND : EXITCOMMAND, Bytes());
+    // silence at the end for wav players which fade out the sound
+    for (int k = 0; k < 10; k++) signal.insert(signal.end(), (int)(SILENCE * sampleRate), 0.0);
+    return signal;
+  }
+
+private:
+  Signal   signal;
+  double   preambleTime;  // additional preamble of the next frame in seconds
+  uint16_t pageIndex;     // header values are kept from frame to frame like in BootFrame.java
+  uint16_t totalLength;
+  bool     synchronised;  // the bootloader has measured the bit time
+  bool     symbols;       // the frames are sent as symbols
+
+  // the image id is the crc16 of the pages, 0xFFFF means no image in the bootloader
+  static uint16_t imageId(const Bytes &data)
+  {
+    int pages = (data.size() + PAGESIZE - 1) / PAGESIZE;
+    uint16_t crc = 0xFFFF;
+
+    for (int n = 0; n < pages * PAGESIZE; n++) crc = frameCrcUpdate(crc, n < (int)data.size() ? data[n] : 0xFF);
+    return crc == 0xFFFF ? 0xFFFE : crc;
+  }
+
+  // a page of a compressed or multi page frame: with chapters the bootloader marks each page
+  // in the EEPROM, the next page waits for this write ( USE_RESUME )
+  double pageProgrammingTime() const
+  {
+    return PROGRAMMINGTIME + (chapterPages > 0 ? EEPROMWRITETIME : 0);
+  }
+
+  // compressed frames end after the data ( totalLength bytes ), multi page frames after the header
+  int dataSize(uint8_t command) const
+  {
+    if (command == COMPRESSEDCOMMAND) return totalLength;
+    if (command == MULTIPAGECOMMAND) return 0;
+    return PAGESIZE;
+  }
+
+  int frameSize(uint8_t command) const
+  {
+    return DATAPAGESTART + dataSize(command) + (fecData() ? FECLANES + 1 : 0);
+  }
+
+  // symbol frames have no FEC data
+  bool fecData() const
+  {
+    return fec && !symbols;
+  }
+
+  double frameDuration(uint8_t command) const
+  {
+    return (1 + syncBits() + frameSize(command) * (symbols ? 4 : 8)) * samplesPerBit() / sampleRate;
+  }
+
+  // symbol frames are synchronised by their own preamble
+  int syncBits() const
+  {
+    return shortSync && synchronised && !symbols ? SHORTSYNCBITS : SYNCBITS;
+  }
+
+  // the frame bits are interleaved into FECLANES lanes, see fecCorrect() in TinyAudioBoot.c
+  static void addFec(Bytes &frame, int protectedBytes)
+  {
+    uint8_t parity = 0;
+
+    for (int k = 0; k < FECLANES; k++) frame[protectedBytes + k] = 0;
+    for (int n = 0; n < protectedBytes * 8; n++)
+    {
+      if ((frame[n / 8] << (n % 8)) & 0x80)
+      {
+        frame[protectedBytes + n % FECLANES] ^= n / FECLANES + 1;
+        parity ^= 1 << (n % FECLANES);
+      }
+    }
+    frame[protectedBytes + FECLANES] = parity;
+  }
+
+  Bytes makeFrame(uint8_t command, const Bytes &data)
+  {
+    Bytes frame(frameSize(command), 0);
+    int size = dataSize(command);
+
+    for (int n = 0; n < size; n++)
+    {
+      if (command == RUNCOMMAND || command == EXITCOMMAND || command == SYMBOLMODECOMMAND) break;
+      frame[DATAPAGESTART + n] = n < (int)data.size() ? data[n] : 0xFF;
+    }
+    frame[COMMAND]       = command;
+    frame[PAGEINDEXLOW]  = pageIndex & 0xFF;
+    frame[PAGEINDEXHIGH] = pageIndex >> 8;
+    frame[LENGTHLOW]     = totalLength & 0xFF;
+    frame[LENGTHHIGH]    = totalLength >> 8;
+
+    uint16_t crc = frameCrc(frame.data(), DATAPAGESTART + size);
+    frame[CRCLOW]  = crc & 0xFF;
+    frame[CRCHIGH] = crc >> 8;
+    if (fecData()) addFec(frame, DATAPAGESTART + size);
+    return frame;
+  }
+
+  // 0 bits of the next frame, the preamble is lengthened while the bootloader is still programming
+  int preambleBits()
+  {
+    int bits = syncBits() + (int)std::ceil(preambleTime * sampleRate / samplesPerBit());
+
+    preambleTime = 0;
+    synchronised = true;
+    return bits;
+  }
+
+  void sendFrame(uint8_t command, const Bytes &data)
+  {
+    ManchesterEncoder encoder(samplesPerBit(), preEmphasisTime * sampleRate);
+
+    if (symbols) encoder.appendSymbols(makeFrame(command, data), preambleBits(), invertSymbols);
+    else encoder.append(makeFrame(command, data), preambleBits());
+    Signal s = encoder.end();
+    signal.insert(signal.end(), s.begin(), s.end());
+  }
+
+  // header and numPages page blocks of checksum and data, see receivePages() in TinyAudioBoot.c
+  void sendMultiPage(const Bytes &data, int numPages)
+  {
+    ManchesterEncoder encoder(samplesPerBit(), preEmphasisTime * sampleRate);
+    int firstByte = pageIndex * PAGESIZE;
+
+    totalLength = numPages * PAGESIZE;
+    encoder.append(makeFrame(MULTIPAGECOMMAND, Bytes()), preambleBits());
+    for (int k = 0; k < numPages; k++)
+    {
+      Bytes block(2 + PAGESIZE + (fecData() ? FECLANES + 1 : 0), 0);
+      uint16_t crc = 0xFFFF;
+
+      for (int n = 0; n < PAGESIZE; n++)
+      {
+        int i = firstByte + k * PAGESIZE + n;
+        block[2 + n] = i < (int)data.size() ? data[i] : 0xFF;
+        crc = frameCrcUpdate(crc, block[2 + n]);
+      }
+      block[0] = crc & 0xFF;
+      block[1] = crc >> 8;
+      if (fecData()) addFec(block, 2 + PAGESIZE);
+
+      // the 0 bits before the block cover the programming time of the previous page
+      int zeroBits = blockGapBits;
+      if (k > 0) zeroBits += (int)std::ceil(pageProgrammingTime() * sampleRate / samplesPerBit());
+      encoder.append(block, zeroBits);
+    }
+    Signal s = encoder.end();
+    signal.insert(signal.end(), s.begin(), s.end());
+  }
+
+  // start of a chapter: image id, image length and the first word of the image, see
+  // WavCodeGenerator.makeImageCommand(). The playback may start again at this frame after a reset.
+  // A new session clears the page bitmap, the signal waits for RESUMESIZE EEPROM writes.
+  void sendImage(const Bytes &data)
+  {
+    Bytes first(PAGESIZE, 0xFF);
+    double clearTime = RESUMESIZE * EEPROMWRITETIME;
+
+    for (int n = 0; n < 2 && n < (int)data.size(); n++) first[n] = data[n];
+    pageIndex = imageId(data);
+    totalLength = data.size();
+    synchronised = false;
+    sendFrame(IMAGECOMMAND, first);
+    waitFor(clearTime, SILENCE + clearTime);
+  }
+
+  // the bootloader is busy: longer preamble of the next frame or silence ( in seconds )
+  void waitFor(double preamble, double silence)
+  {
+    if (gapless) preambleTime = preamble;
+    else signal.insert(signal.end(), (int)(silence * sampleRate), 0.0);
+  }
+};
+
+#endif
@@ -0,0 +1,347 @@
+/*
+  harness.c - run the real TinyAudioBoot firmware against a WAV file on the host
+
+  usage: audioboot_sim [options] file.wav [file.hex]
+         file.wav may be - to read a streamed WAV file from stdin
+
+  The bootloader is reset, the WAV file is played into the audio input
+  and the firmware runs until it starts the application or the signal
+  ends. The decoded frames, the resulting flash image compared to the
+  source .hex file and a throughput summary are reported.
+
+  The supply current is estimated from the time awake and asleep with the
+  typical values of the datasheet at 5V, it is not a measurement. The
+  input bias divider and the LED come on top of it.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "hostsim.h"
+#include "AudioBootFrame.h"
+#include "wavio.h"
+
+int bootloader_main(void);
+
+// statistics of optional firmware features, not linked if the option is disabled
+extern uint16_t FecCorrections __attribute__((weak));
+extern uint16_t SkippedPages __attribute__((weak));
+extern uint16_t ClockCorrection __attribute__((weak));
+
+#define MAXFRAMES 4096
+
+typedef struct
+{
+  double   time;
+  uint8_t  header[DATAPAGESTART];
+  uint16_t payload;   // flash bytes carried by the frame
+  uint8_t  ok;
+} frame_t;
+
+static frame_t  frames[MAXFRAMES];
+static uint32_t numFrames;
+static uint8_t  verbose = 1;
+
+static uint8_t  image[SIM_FLASHSIZE];
+static uint8_t  imageUsed[SIM_FLASHSIZE];
+static uint32_t imageSize;
+static uint8_t  eepromImage[SIM_FLASHSIZE];
+static uint8_t  eepromUsed[SIM_FLASHSIZE];
+static uint32_t eepromSize;
+
+//***************************************************************************************
+// flash bytes of a programming, compressed or multi page frame ( token format see decompressPages() )
+// or EEPROM bytes of an EEPROM frame
+//***************************************************************************************
+static uint16_t framePayload(const uint8_t *frame, uint16_t size)
+{
+  uint16_t n = DATAPAGESTART, end = DATAPAGESTART + frame[LENGTHLOW], payload = 0;
+
+  if (frame[COMMAND] == PROGCOMMAND) return SIM_PAGESIZE;
+  if (frame[COMMAND] == EEPROMCOMMAND) return frame[LENGTHLOW] < SIM_PAGESIZE ? frame[LENGTHLOW] : SIM_PAGESIZE;
+  if (frame[COMMAND] == MULTIPAGECOMMAND) return (frame[LENGTHLOW] | (frame[LENGTHHIGH] << 8)) & ~(SIM_PAGESIZE - 1);
+  if (frame[COMMAND] != COMPRESSEDCOMMAND) return 0;
+
+  if (end > size) end = size;
+  while (n < end)
+  {
+    uint8_t c = frame[n++];
+
+    if (c & 0x80) { payload += (c & 0x7F) + 3; n += 2; }
+    else          { payload += c + 1; n += c + 1; }
+  }
+  return payload;
+}
+
+//***************************************************************************************
+// firmware hook: called after each receiveFrame()
+//***************************************************************************************
+void sim_frame(const uint8_t *frame, uint16_t size, uint8_t ok)
+{
+  frame_t *f;
+
+  if (numFrames == MAXFRAMES) return;
+  f = &frames[numFrames++];
+  f->time = sim_seconds();
+  memcpy(f->header, frame, size < sizeof(f->header) ? size : sizeof(f->header));
+  f->payload = framePayload(frame, size);
+  f->ok = ok;
+
+  if (verbose)
+  {
+    printf("frame %4u  t=%8.4fs  cmd=%u page=%-4u len=%-5u crc=0x%04X payload=%-4u %s\n",
+           numFrames, f->time, f->header[0],
+           f->header[1] | (f->header[2] << 8),
+           f->header[3] | (f->header[4] << 8),
+           f->header[5] | (f->header[6] << 8),
+           f->payload, ok ? "ok" : "FAILED");
+  }
+}
+
+//***************************************************************************************
+// report
+//***************************************************************************************
+// the state of the device for the next run: flash as name.hex, EEPROM as name.eep
+static int writeHex(const char *name, const uint8_t *data, uint32_t size)
+{
+  FILE *fp = fopen(name, "w");
+  uint32_t a, n;
+
+  if (!fp) { perror(name); return 0; }
+
+  for (a = 0; a < size; a += 16)
+  {
+    uint8_t sum = 16 + (a >> 8) + a;
+
+    fprintf(fp, ":10%04X00", a);
+    for (n = 0; n < 16; n++)
+    {
+      fprintf(fp, "%02X", data[a + n]);
+      sum += data[a + n];
+    }
+    fprintf(fp, "%02X\n", (uint8_t)-sum);
+  }
+  fprintf(fp, ":00000001FF\n");
+  fclose(fp);
+  return 1;
+}
+
+static int saveState(const char *name)
+{
+  char file[FILENAME_MAX];
+
+  snprintf(file, sizeof(file), "%s.hex", name);
+  if (!writeHex(file, sim.flash, SIM_FLASHSIZE)) return 0;
+  snprintf(file, sizeof(file), "%s.eep", name);
+  return writeHex(file, sim.eeprom, SIM_EEPROMSIZE);
+}
+
+static int compareEeprom(void)
+{
+  uint32_t a, errors = 0, compared = 0;
+
+  for (a = 0; a < SIM_EEPROMSIZE; a++)
+  {
+    if (!eepromUsed[a]) continue;
+    compared++;
+    if (sim.eeprom[a] != eepromImage[a])
+    {
+      if (errors < 16)
+        printf("  mismatch at EEPROM 0x%03X: 0x%02X, eep 0x%02X\n", a, sim.eeprom[a], eepromImage[a]);
+      errors++;
+    }
+  }
+  printf("eeprom image  : %u of %u bytes differ from eep\n", errors, compared);
+  return errors;
+}
+
+static int compareImage(void)
+{
+  uint32_t a, errors = 0, compared = 0;
+
+  for (a = 0; a < SIM_FLASHSIZE; a++)
+  {
+    if (!imageUsed[a]) continue;
+    if (a < 2) continue; // the reset vector is patched to jump into the bootloader
+    compared++;
+    if (sim.flash[a] != image[a])
+    {
+      if (errors < 16)
+        printf("  mismatch at 0x%04X: flash 0x%02X, hex 0x%02X\n", a, sim.flash[a], image[a]);
+      errors++;
+    }
+  }
+  printf("flash image   : %u of %u bytes differ from hex", errors, compared);
+
+  if (imageUsed[0] && imageUsed[1])
+  {
+    // rjmp at address 0: application start as word address
+    uint16_t w = image[0] | (image[1] << 8);
+    uint16_t expected = (w + 1) & 0x0FFF;
+
+    if (sim.exitReason == SIM_APP_STARTED)
+    {
+      printf(", application start 0x%04X (expected 0x%04X)", sim.applicationAddress, expected);
+      if (sim.applicationAddress != expected) errors++;
+    }
+  }
+  printf("\n");
+  return errors;
+}
+
+// typical supply current at 5V in mA, 16MHz PLL clock
+#define CURRENT_ACTIVE    9.0
+#define CURRENT_IDLE      2.5
+#define CURRENT_POWERDOWN 0.007  // watchdog running
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: audioboot_sim [options] file.wav [file.hex]\n"
+          "  file.wav       - reads a streamed WAV file from stdin\n"
+          "  -g gain        volume scaling of the signal ( default 1.0 )\n"
+          "  -t threshold   digital switching level in fractions of VCC ( default 0.5 )\n"
+          "  -y hysteresis  schmitt trigger width in fractions of VCC ( default 0.0 )\n"
+          "  -c cycles      CPU cycles per register access in polling loops ( default 4 )\n"
+          "  -C channel     WAV channel to play ( default 0 = left )\n"
+          "  -f file.hex    initial flash content\n"
+          "  -E file.eep    initial EEPROM content\n"
+          "  -e file.eep    expected EEPROM content\n"
+          "  -s seconds     silence appended to the WAV ( default 1.0 )\n"
+          "  -r percent     playback sample rate error ( default 0 )\n"
+          "  -d percent     change of the sample rate error per second ( default 0 )\n"
+          "  -z             hold each sample instead of interpolating like a DAC\n"
+          "  -H us          time constant of the input high pass ( default 0 = DC coupled )\n"
+          "  -W us          clock start-up time after power-down ( default 64 = 1K CK )\n"
+          "  -n             bootloader button not pressed at reset\n"
+          "  -w name        save flash and EEPROM as name.hex and name.eep for the next run\n"
+          "  -q             do not list the frames\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t numSamples = 0, sampleRate = 0;
+  const char *initialHex = NULL, *initialEeprom = NULL, *expectedEeprom = NULL, *state = NULL;
+  uint8_t channel = 0;
+  uint32_t n, ok = 0, failed = 0, payload = 0, eepromBytes = 0;
+  int opt, errors = 0;
+  float *samples;
+  double seconds, highPassTime = 0, awake;
+
+  sim.gain = 1.0;
+  sim.threshold = 0.5;
+  sim.hysteresis = 0.0;
+  sim.cyclesPerAccess = 4;
+  sim.tailSeconds = 1.0;
+  sim.buttonPressed = 1;
+  sim.interpolate = 1;
+  sim.wakeupTime = 64e-6;
+
+  while ((opt = getopt(argc, argv, "g:t:y:c:C:f:E:e:s:r:d:zH:W:nw:q")) != -1)
+  {
+    switch (opt)
+    {
+      case 'g': sim.gain = atof(optarg); break;
+      case 't': sim.threshold = atof(optarg); break;
+      case 'y': sim.hysteresis = atof(optarg); break;
+      case 'c': sim.cyclesPerAccess = atoi(optarg); break;
+      case 'C': channel = atoi(optarg); break;
+      case 'f': initialHex = optarg; break;
+      case 'E': initialEeprom = optarg; break;
+      case 'e': expectedEeprom = optarg; break;
+      case 's': sim.tailSeconds = atof(optarg); break;
+      case 'r': sim.clockError = atof(optarg) / 100; break;
+      case 'd': sim.clockDrift = atof(optarg) / 100; break;
+      case 'z': sim.interpolate = 0; break;
+      case 'H': highPassTime = atof(optarg) * 1e-6; break;
+      case 'W': sim.wakeupTime = atof(optarg) * 1e-6; break;
+      case 'n': sim.buttonPressed = 0; break;
+      case 'w': state = optarg; break;
+      case 'q': verbose = 0; break;
+      default: usage();
+    }
+  }
+  if (optind >= argc) usage();
+
+  samples = readWav(argv[optind], channel, &numSamples, &sampleRate);
+  if (!samples) return 2;
+  if (highPassTime > 0) highPass(samples, numSamples, sampleRate, highPassTime);
+  sim.samples = samples;
+  sim.numSamples = numSamples;
+  sim.sampleRate = sampleRate;
+
+  sim_reset();
+  if (initialHex)
+  {
+    uint8_t used[SIM_FLASHSIZE];
+    uint32_t size = 0;
+    if (!readHex(initialHex, sim.flash, used, &size)) return 2;
+  }
+  if (initialEeprom)
+  {
+    uint8_t data[SIM_FLASHSIZE], used[SIM_FLASHSIZE];
+    uint32_t a, size = 0;
+    memset(used, 0, sizeof(used));
+    if (!readHex(initialEeprom, data, used, &size)) return 2;
+    for (a = 0; a < SIM_EEPROMSIZE; a++) if (used[a]) sim.eeprom[a] = data[a];
+  }
+  if (expectedEeprom && !readHex(expectedEeprom, eepromImage, eepromUsed, &eepromSize)) return 2;
+  if (optind + 1 < argc && !readHex(argv[optind + 1], image, imageUsed, &imageSize)) return 2;
+
+  sim_run(bootloader_main);
+  if (state && !saveState(state)) return 2;
+
+  for (n = 0; n < numFrames; n++)
+  {
+    if (!frames[n].ok) failed++;
+    else
+    {
+      ok++;
+      payload += frames[n].payload;
+      if (frames[n].header[COMMAND] == EEPROMCOMMAND) eepromBytes += frames[n].payload;
+    }
+  }
+  seconds = sim.exitReason == SIM_APP_STARTED ? sim_seconds() : (double)numSamples / sampleRate;
+
+  printf("signal        : %s, %u Hz, %.3f s\n", argv[optind], sampleRate, (double)numSamples / sampleRate);
+  printf("result        : %s after %.3f s\n",
+         sim.exitReason == SIM_APP_STARTED ? "application started" : "end of signal", sim_seconds());
+  if (sim.exitReason == SIM_APP_STARTED)
+    printf("latency       : %.3f ms from reset to the application\n", 1000.0 * sim.resetToAppCycles / F_CPU);
+  printf("frames        : %u ok, %u failed\n", ok, failed);
+  printf("flash         : %u page erases, %u page writes, %.1f ms CPU halted in SPM\n",
+         sim.pageErases, sim.pageWrites, 1000.0 * sim.spmCycles / F_CPU);
+  if (sim.spmBlocked)
+    printf("spm blocked   : %u page erases or writes ignored during an EEPROM write\n", sim.spmBlocked);
+  if (&SkippedPages)
+    printf("unchanged     : %u pages skipped, %.1f ms SPM time saved\n",
+           SkippedPages, SkippedPages * 2000.0 * SIM_TWD_FLASH);
+  printf("eeprom        : %u bytes received, %u byte writes\n", eepromBytes, sim.eepromWrites);
+  if (&FecCorrections) printf("fec           : %u bits corrected\n", FecCorrections);
+  if (&ClockCorrection) printf("clock         : sample delay corrected by up to %u timer ticks\n", ClockCorrection);
+  if (sim.idleCycles || sim.powerDownCycles)
+  {
+    awake = sim_seconds() - (double)(sim.idleCycles + sim.powerDownCycles) / F_CPU;
+    printf("sleep         : %.3f s idle, %.3f s power-down, %.3f s awake\n",
+           (double)sim.idleCycles / F_CPU, (double)sim.powerDownCycles / F_CPU, awake);
+    printf("current       : %.3f mA average ( datasheet estimate )\n",
+           (awake * CURRENT_ACTIVE + (double)sim.idleCycles / F_CPU * CURRENT_IDLE +
+            (double)sim.powerDownCycles / F_CPU * CURRENT_POWERDOWN) / sim_seconds());
+  }
+  printf("throughput    : %u payload bytes in %.3f s = %.0f bit/s\n",
+         payload, seconds, seconds > 0 ? payload * 8 / seconds : 0.0);
+
+  if (imageSize) errors = compareImage();
+  if (eepromSize) errors += compareEeprom();
+  if (failed) errors++;
+  if (sim.spmBlocked) errors++;
+
+  free(samples);
+  return errors ? 1 : 0;
+}
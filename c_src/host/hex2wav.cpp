@@ -0,0 +1,300 @@
+/*
+  hex2wav.cpp - native wav generator for the audio bootloader
+
+  usage: hex2wav [options] file.hex [file.eep]
+         file.hex may be - to send only the EEPROM data of file.eep
+
+  The frames are built with the definitions of AudioBootFrame.h, the same
+  header the bootloader is compiled with. The signal is the one of the Java
+  generator ( wavCreator/WavCodeGenerator.java ) with its default settings:
+  gapless frames with a longer preamble while the bootloader is programming,
+  differential manchester code and band limited edges if half a bit is not a
+  whole number of samples, see encoder.h. With -R the right channel programs a
+  second image like WavCodeGenerator.writeStereoWav(). The optional frame types
+  need a bootloader compiled with the matching USE_ option, e.g. -c compressed
+  frames with USE_COMPRESSION.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <getopt.h>
+#include "encoder.h"
+
+//***************************************************************************************
+// intel hex file: the bytes from address 0 to the last byte in the file, gaps are 0xFF
+//***************************************************************************************
+static bool readHex(const char *fileName, std::vector<int> &memory, int limit)
+{
+  FILE *fp = fopen(fileName, "r");
+  char line[600];
+  uint32_t base = 0;
+
+  if (!fp) return false;
+  while (fgets(line, sizeof(line), fp))
+  {
+    uint8_t b[260];
+    int n;
+
+    if (line[0] != ':') continue;
+    for (n = 0; n < 260 && isxdigit((unsigned char)line[1 + 2 * n]) && isxdigit((unsigned char)line[2 + 2 * n]); n++)
+    {
+      char hex[3] = { line[1 + 2 * n], line[2 + 2 * n], 0 };
+      b[n] = strtol(hex, 0, 16);
+    }
+    if (n < 5 || n < 5 + b[0]) continue;
+
+    uint32_t address = base + ((b[1] << 8) | b[2]);
+    if (b[3] == 0)
+    {
+      for (int k = 0; k < b[0] && (int)(address + k) < limit; k++)
+      {
+        if (address + k >= memory.size()) memory.resize(address + k + 1, -1);
+        memory[address + k] = b[4 + k];
+      }
+    }
+    else if (b[3] == 1) break;
+    else if (b[3] == 2) base = ((b[4] << 8) | b[5]) << 4;
+    else if (b[3] == 4) base = ((b[4] << 8) | b[5]) << 16;
+  }
+  fclose(fp);
+  return true;
+}
+
+//***************************************************************************************
+// cue chunk and LIST adtl chunk with the labels of the chapters, see WavFile.writeCueChunks()
+//***************************************************************************************
+static std::vector<uint8_t> cueChunks(const std::vector<Generator::Chapter> &chapters)
+{
+  std::vector<uint8_t> cue, labels;
+  auto put = [](std::vector<uint8_t> &chunk, uint32_t value) { for (int n = 0; n < 4; n++) chunk.push_back(value >> (8 * n)); };
+  auto id = [](std::vector<uint8_t> &chunk, const char *name) { chunk.insert(chunk.end(), name, name + 4); };
+
+  if (chapters.empty()) return cue;
+  id(cue, "cue "); put(cue, 4 + 24 * chapters.size()); put(cue, chapters.size());
+  for (size_t n = 0; n < chapters.size(); n++)
+  {
+    std::string text = "page " + std::to_string(chapters[n].page);
+
+    put(cue, n + 1); put(cue, chapters[n].position); id(cue, "data"); put(cue, 0); put(cue, 0); put(cue, chapters[n].position);
+    id(labels, "labl"); put(labels, 4 + text.size() + 1); put(labels, n + 1);
+    labels.insert(labels.end(), text.begin(), text.end() + 1);
+    if ((text.size() + 1) % 2) labels.push_back(0);
+  }
+  id(cue, "LIST"); put(cue, 4 + labels.size()); id(cue, "adtl");
+  cue.insert(cue.end(), labels.begin(), labels.end());
+  return cue;
+}
+
+//***************************************************************************************
+// 16 bit stereo, the same quantisation as WavFile.java, "-" writes to stdout
+// the channels have the same length, the chapters are marked by cue points
+//***************************************************************************************
+static bool writeWav(const char *fileName, const Signal &left, const Signal &right, int sampleRate,
+                     const std::vector<Generator::Chapter> &chapters)
+{
+  FILE *fp = strcmp(fileName, "-") ? fopen(fileName, "wb") : stdout;
+  uint32_t dataSize = left.size() * 4;
+  uint8_t header[44];
+  std::vector<uint8_t> data(dataSize), cue = cueChunks(chapters);
+
+  if (!fp) return false;
+  auto put = [&](int offset, uint32_t value, int bytes) { for (int n = 0; n < bytes; n++) header[offset + n] = value >> (8 * n); };
+  memcpy(header, "RIFF", 4);      put(4, 36 + dataSize + cue.size(), 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  put(16, 16, 4); put(20, 1, 2); put(22, 2, 2);
+  put(24, sampleRate, 4); put(28, sampleRate * 4, 4); put(32, 4, 2); put(34, 16, 2);
+  memcpy(header + 36, "data", 4); put(40, dataSize, 4);
+
+  for (size_t n = 0; n < left.size(); n++)
+  {
+    for (int c = 0; c < 2; c++)
+    {
+      int16_t value = (int16_t)(long)(32767 * (c ? right[n] : left[n]));
+      data[4 * n + 2 * c]     = value & 0xFF;
+      data[4 * n + 2 * c + 1] = (value >> 8) & 0xFF;
+    }
+  }
+  bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header) && fwrite(data.data(), 1, dataSize, fp) == dataSize &&
+            fwrite(cue.data(), 1, cue.size(), fp) == cue.size();
+  if (fp != stdout) ok = fclose(fp) == 0 && ok;
+  else ok = fflush(fp) == 0 && ok;
+  return ok;
+}
+
+// flash and EEPROM data, hexFile "-": no flash data, eepFile NULL: no EEPROM frames
+static bool readImage(const char *hexFile, const char *eepFile, Bytes &data, std::vector<int> &eeprom)
+{
+  std::vector<int> flash;
+
+  if (strcmp(hexFile, "-") && !readHex(hexFile, flash, 0x10000))
+  {
+    fprintf(stderr, "can not read %s\n", hexFile);
+    return false;
+  }
+  if (eepFile)
+  {
+    if (!readHex(eepFile, eeprom, EEPROMSIZE))
+    {
+      fprintf(stderr, "can not read %s\n", eepFile);
+      return false;
+    }
+    eeprom.resize(EEPROMSIZE, -1);
+  }
+  data.resize(flash.size());
+  for (size_t n = 0; n < flash.size(); n++) data[n] = flash[n] < 0 ? 0xFF : flash[n];
+  return true;
+}
+
+/* the bootloader keeps its own data in the last EEPROM bytes: the resume state of a wav with
+ * chapters is rejected, the fast start window ( a wav with lead in ) may be set on purpose
+ */
+static bool checkEeprom(const Generator &generator, const std::vector<int> &eeprom)
+{
+  int address = eepromDataFrom(eeprom, RESUMESTATE);
+
+  if (generator.chapterPages > 0 && address >= 0)
+  {
+    fprintf(stderr, "EEPROM byte %d: the bytes from %d on hold the resume state of USE_RESUME\n", address, RESUMESTATE);
+    return false;
+  }
+  if (generator.leadInTime > 0 && eepromDataFrom(eeprom, FASTSTARTCONFIG) == FASTSTARTCONFIG)
+  {
+    fprintf(stderr, "warning: EEPROM byte %d sets the start window of USE_FASTSTART to %d ms\n",
+            FASTSTARTCONFIG, eeprom[FASTSTARTCONFIG]);
+  }
+  return true;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: hex2wav [options] file.hex [file.eep]\n"
+          "  -o file   output wav file, - for stdout ( default: file.hex with .wav )\n"
+          "  -r rate   sample rate in Hz ( default 44100 )\n"
+          "  -b rate   bit rate in bit/s ( default: full speed 11025 )\n"
+          "  -s        half speed\n"
+          "  -g        silence between the frames instead of gapless frames\n"
+          "  -F        forward error correction ( bootloader with USE_FEC )\n"
+          "  -q        EEPROM queue ( bootloader with USE_EEPROMQUEUE )\n"
+          "  -l sec    lead in before the first frame ( bootloader with USE_FASTSTART )\n"
+          "  -p us     pre-emphasis for the input high pass with this time constant\n"
+          "  -S        full preamble only on the first frame ( bootloader with USE_SHORTSYNC )\n"
+          "  -c        compressed frames ( bootloader with USE_COMPRESSION )\n"
+          "  -m pages  pages per frame ( bootloader with USE_MULTIPAGE )\n"
+          "  -a        4 level amplitude symbols ( bootloader with USE_ADC_SYMBOLS )\n"
+          "  -i        inverted symbols for an inverting input circuit\n"
+          "  -C pages  chapters of this many pages with cue points ( bootloader with USE_RESUME )\n"
+          "  -R file   image of the right channel, file.hex is sent on the left one\n"
+          "  -E file   EEPROM data of the right channel\n"
+          "  -j cue    start the wav at this cue point, counted from 1 ( a resumed playback )\n"
+          "  -k n      end the wav after n samples ( an interrupted playback )\n"
+          "  file.hex may be - for a wav with only the EEPROM data\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  Generator generator;
+  std::string output;
+  const char *rightHex = NULL, *rightEep = NULL;
+  int opt, firstCue = 0;
+  long lastSample = -1;
+
+  while ((opt = getopt(argc, argv, "o:r:b:sgFql:p:Scm:aiC:R:E:j:k:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'o': output = optarg; break;
+      case 'r': generator.sampleRate = atoi(optarg); break;
+      case 'b': generator.bitRate = atof(optarg); break;
+      case 's': generator.fullSpeed = false; break;
+      case 'g': generator.gapless = false; break;
+      case 'F': generator.fec = true; break;
+      case 'q': generator.eepromQueue = true; break;
+      case 'l': generator.leadInTime = atof(optarg); break;
+      case 'p': generator.preEmphasisTime = atof(optarg) * 1e-6; break;
+      case 'S': generator.shortSync = true; break;
+      case 'c': generator.compression = true; break;
+      case 'm': generator.pagesPerFrame = atoi(optarg); break;
+      case 'a': generator.symbolMode = true; break;
+      case 'i': generator.invertSymbols = true; break;
+      case 'C': generator.chapterPages = atoi(optarg); break;
+      case 'R': rightHex = optarg; break;
+      case 'E': rightEep = optarg; break;
+      case 'j': firstCue = atoi(optarg); break;
+      case 'k': lastSample = atol(optarg); break;
+      default: usage();
+    }
+  }
+  if (optind >= argc || generator.sampleRate <= 0 || generator.pagesPerFrame < 1) usage();
+  if (generator.samplesPerBit() < 2)
+  {
+    fprintf(stderr, "at least 2 samples per bit are needed\n");
+    return 1;
+  }
+
+  const char *hexFile = argv[optind];
+  Bytes data, rightData;
+  std::vector<int> eeprom, rightEeprom;
+  if (!readImage(hexFile, optind + 1 < argc ? argv[optind + 1] : NULL, data, eeprom)) return 1;
+  if (rightHex && !readImage(rightHex, rightEep, rightData, rightEeprom)) return 1;
+  if (!checkEeprom(generator, eeprom) || !checkEeprom(generator, rightEeprom)) return 1;
+
+  if (output.empty())
+  {
+    output = strcmp(hexFile, "-") ? hexFile : argv[argc - 1];
+    size_t dot = output.find_last_of('.'), slash = output.find_last_of('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) output.erase(dot);
+    output += ".wav";
+  }
+
+  Signal signal = generator.generate(data, eeprom), right = signal;
+  std::vector<Generator::Chapter> chapters = generator.chapters;
+  if (rightHex)
+  {
+    // the shorter channel waits before its RUN frame, so both devices start at the same time
+    size_t leftEnd = generator.endFramePosition;
+    right = generator.generate(rightData, rightEeprom);
+    size_t rightEnd = generator.endFramePosition;
+    if (leftEnd < rightEnd) signal.insert(signal.begin() + leftEnd, rightEnd - leftEnd, 0.0);
+    else right.insert(right.begin() + rightEnd, leftEnd - rightEnd, 0.0);
+    signal.resize(std::max(signal.size(), right.size()), 0.0);
+    right.resize(signal.size(), 0.0);
+    // the chapters of the two channels are at different positions
+    chapters.clear();
+  }
+  // a part of the playback for the tests of USE_RESUME, the cue points of the part are kept
+  if (lastSample >= 0 && lastSample < (long)signal.size())
+  {
+    signal.resize(lastSample);
+    right.resize(lastSample);
+    while (!chapters.empty() && chapters.back().position >= (size_t)lastSample) chapters.pop_back();
+  }
+  if (firstCue > 0)
+  {
+    if (firstCue > (int)chapters.size())
+    {
+      fprintf(stderr, "there are only %u cue points\n", (unsigned)chapters.size());
+      return 1;
+    }
+    size_t start = chapters[firstCue - 1].position;
+    signal.erase(signal.begin(), signal.begin() + start);
+    right.erase(right.begin(), right.begin() + start);
+    chapters.erase(chapters.begin(), chapters.begin() + firstCue - 1);
+    for (auto &chapter : chapters) chapter.position -= start;
+  }
+  if (!writeWav(output.c_str(), signal, right, generator.sampleRate, chapters))
+  {
+    fprintf(stderr, "can not write %s\n", output.c_str());
+    return 1;
+  }
+  fprintf(stderr, "%s: %u bytes flash, %.3f s\n", output.c_str(), (unsigned)data.size(), (double)signal.size() / generator.sampleRate);
+  return 0;
+}
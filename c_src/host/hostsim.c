@@ -0,0 +1,489 @@
+/*
+  hostsim.c - emulated Attiny85 peripherals for the firmware-in-the-loop harness
+
+  see hostsim.h for the simulation model
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <string.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+sim_t sim;
+
+uint8_t sim_reg[SIM_NUMREGS];
+
+volatile uint8_t  DDRB, PORTB, SREG, TCCR0A, TCCR0B, TCCR1, ADMUX, EEDR, SPMCSR, PCMSK, GIMSK, MCUCR;
+volatile uint16_t EEAR;
+
+static uint64_t timer0Updated;    // cycle count of the last TCNT0 update
+static uint64_t timer1Ticks;      // TCNT1 ticks since the clock selection was changed
+static uint8_t  timer1Clock;      // TCCR1 clock select and PCKE of this count
+static uint64_t eepromReady;      // end of the running EEPROM write
+static uint64_t adcReady;         // end of the running ADC conversion
+static uint8_t  adcValue;
+static uint64_t endOfInput;       // WAV file and trailing silence consumed
+static uint8_t  pinChangeFlag;    // PCIF
+static uint8_t  pinChangeLevel;   // audio pin level at the last update of PCIF
+static uint8_t  pinChangeMask;    // PCMSK at the last update of PCIF
+static uint8_t  gifrAccessed;     // GIFR was returned by the last register access
+static uint8_t  wdtConfig;        // WDTCR without WDIF and WDCE
+static uint8_t  wdtFlag;          // WDIF
+static uint64_t wdtTimeout;       // cycle count of the next watchdog time-out
+static uint8_t  wdtcrAccessed;    // WDTCR was returned by the last register access
+
+#define SECONDS(s) ((uint64_t)((s) * (double)F_CPU))
+
+//***************************************************************************************
+// analog input
+//
+// The audio signal is AC coupled onto a VCC/2 bias, the level is returned
+// as fraction of VCC. The reconstruction filter of the DAC is approximated
+// by linear interpolation, so edges between two samples keep their time.
+//***************************************************************************************
+static double playbackPosition(double seconds)
+{
+  return sim.sampleRate * (seconds * (1 + sim.clockError) + 0.5 * sim.clockDrift * seconds * seconds);
+}
+
+static double analogLevel(void)
+{
+  double position = playbackPosition((double)sim.cycles / F_CPU);
+  uint64_t n = position < 0 ? sim.numSamples : (uint64_t)position;
+  double level = 0.5;
+  double sample;
+
+  if (n < sim.numSamples)
+  {
+    sample = sim.samples[n];
+    if (sim.interpolate && n + 1 < sim.numSamples)
+      sample += (position - n) * (sim.samples[n + 1] - sample);
+    level += 0.5 * sim.gain * sample;
+  }
+
+  if (level < 0) level = 0;
+  if (level > 1) level = 1;
+  return level;
+}
+
+static uint8_t digitalLevel(void)
+{
+  double level = analogLevel();
+
+  if (sim.pinLevel)
+  {
+    if (level < sim.threshold - sim.hysteresis / 2) sim.pinLevel = 0;
+  }
+  else
+  {
+    if (level > sim.threshold + sim.hysteresis / 2) sim.pinLevel = 1;
+  }
+  return sim.pinLevel;
+}
+
+//***************************************************************************************
+// timer 0: only the prescaler bits of TCCR0B are evaluated
+//***************************************************************************************
+static uint16_t timer0Prescaler(void)
+{
+  switch (TCCR0B & 0x07)
+  {
+    case 1: return 1;
+    case 2: return 8;
+    case 3: return 64;
+    case 4: return 256;
+    case 5: return 1024;
+  }
+  return 0; // stopped or external clock
+}
+
+static void updateTimer0(void)
+{
+  uint16_t prescaler = timer0Prescaler();
+
+  if (prescaler)
+  {
+    uint64_t ticks = (sim.cycles - timer0Updated) / prescaler;
+    sim_reg[SIM_TCNT0] += (uint8_t)ticks;
+    timer0Updated += ticks * prescaler;
+  }
+  else timer0Updated = sim.cycles;
+}
+
+//***************************************************************************************
+// timer 1: prescaler 2^(CS1-1) of the CPU clock or, with PCKE, of the 64MHz PLL clock
+//***************************************************************************************
+static void updateTimer1(void)
+{
+  uint8_t cs = TCCR1 & 0x0F;
+  uint8_t pcke = sim_reg[SIM_PLLCSR] & (1 << PCKE);
+  uint64_t ticks = 0;
+
+  if (cs) ticks = (sim.cycles * (pcke ? 4 : 1)) >> (cs - 1);
+
+  if ((cs | pcke) != timer1Clock)
+  {
+    timer1Clock = cs | pcke;
+    timer1Ticks = ticks;
+  }
+  sim_reg[SIM_TCNT1] += (uint8_t)(ticks - timer1Ticks);
+  timer1Ticks = ticks;
+}
+
+//***************************************************************************************
+// EEPROM: a write is started by setting EEPE, EEPE is cleared after tWD_EEPROM
+//***************************************************************************************
+static void updateEeprom(void)
+{
+  uint8_t eecr = sim_reg[SIM_EECR];
+
+  if (!(eecr & (1 << EEPE))) return;
+
+  if (eepromReady == 0)
+  {
+    uint16_t address = EEAR % SIM_EEPROMSIZE;
+    uint8_t mode = (eecr >> EEPM0) & 0x03;
+
+    if (mode == 0)      sim.eeprom[address] = EEDR;   // erase and write
+    else if (mode == 1) sim.eeprom[address] = 0xFF;   // erase only
+    else                sim.eeprom[address] &= EEDR;  // write only
+    sim.eepromWrites++;
+    eepromReady = sim.cycles + SECONDS(mode ? SIM_TWD_EEPROM / 2 : SIM_TWD_EEPROM);
+  }
+  else if (sim.cycles >= eepromReady)
+  {
+    sim_reg[SIM_EECR] &= ~((1 << EEPE) | (1 << EEMPE));
+    eepromReady = 0;
+  }
+}
+
+//***************************************************************************************
+// ADC: a conversion is started by setting ADSC and takes 13 ADC clock cycles
+// With ADATE set the ADC is free running ( ADCSRB is not emulated ), the next
+// conversion starts when the last one is complete.
+//***************************************************************************************
+static void startAdcConversion(uint8_t adcsra)
+{
+  uint8_t prescaler = 1 << (adcsra & 0x07);
+
+  if (prescaler == 1) prescaler = 2;
+  // the button is released as soon as the bootloader listens to the audio input
+  if (adcsra & (1 << ADATE)) sim.buttonPressed = 0;
+  // sample and hold at the start of the conversion
+  adcValue = sim.buttonPressed ? 0 : (uint8_t)(analogLevel() * 255);
+  adcReady = sim.cycles + 13 * prescaler;
+}
+
+static void updateAdc(void)
+{
+  uint8_t adcsra = sim_reg[SIM_ADCSRA];
+
+  if (!(adcsra & (1 << ADEN)) || !(adcsra & (1 << ADSC))) return;
+
+  if (adcReady == 0) startAdcConversion(adcsra);
+  else if (sim.cycles >= adcReady)
+  {
+    if (ADMUX & (1 << ADLAR))
+    {
+      sim_reg[SIM_ADCH] = adcValue;
+      sim_reg[SIM_ADCL] = 0;
+    }
+    else
+    {
+      sim_reg[SIM_ADCH] = adcValue >> 6;
+      sim_reg[SIM_ADCL] = adcValue << 2;
+    }
+    if (adcsra & (1 << ADATE))
+    {
+      sim_reg[SIM_ADCSRA] = adcsra | (1 << ADIF);
+      startAdcConversion(adcsra);
+    }
+    else
+    {
+      sim_reg[SIM_ADCSRA] = (adcsra & ~(1 << ADSC)) | (1 << ADIF);
+      adcReady = 0;
+    }
+  }
+}
+
+//***************************************************************************************
+// pin change flag: set by a level change of the audio pin ( PB3 and PB4 ) if it is
+// enabled in PCMSK, cleared by writing 1 to PCIF. The write can only be seen at the
+// next register access: GIFR is returned with the reserved bit 7 set, a write clears it.
+//***************************************************************************************
+static void updatePinChange(void)
+{
+  uint8_t mask = PCMSK & ((1 << PB3) | (1 << PB4));
+  uint8_t level;
+
+  if (gifrAccessed)
+  {
+    uint8_t written = sim_reg[SIM_GIFR];
+    if (!(written & 0x80) && (written & (1 << PCIF))) pinChangeFlag = 0;
+    gifrAccessed = 0;
+  }
+  if (!mask)
+  {
+    pinChangeMask = 0;
+    return;
+  }
+  level = digitalLevel();
+  if (pinChangeMask && level != pinChangeLevel) pinChangeFlag = 1;
+  pinChangeLevel = level;
+  pinChangeMask = mask;
+}
+
+//***************************************************************************************
+// watchdog: only the interrupt mode is emulated, WDIF is set every (2048 << WDP) cycles
+// of the 128kHz oscillator. Like GIFR the register is returned with a marker, WDCE,
+// so a write is seen at the next access. Writing 1 to WDIF clears the flag, a write
+// with WDCE is the first half of the timed sequence and does not change the setup.
+//***************************************************************************************
+static uint64_t watchdogPeriod(void)
+{
+  uint8_t wdp = (wdtConfig & 0x07) | ((wdtConfig & (1 << WDP3)) ? 8 : 0);
+
+  return (uint64_t)(2048 << wdp) * F_CPU / SIM_WDT_CLOCK;
+}
+
+static void updateWatchdog(void)
+{
+  if (wdtcrAccessed)
+  {
+    uint8_t written = sim_reg[SIM_WDTCR];
+    uint8_t shown = (1 << WDCE) | wdtConfig | (wdtFlag << WDIF);
+
+    if (written != shown && !(written & (1 << WDCE)))
+    {
+      uint8_t running = wdtConfig & ((1 << WDIE) | (1 << WDE));
+
+      if (written & (1 << WDIF)) wdtFlag = 0;
+      wdtConfig = written & ~((1 << WDIF) | (1 << WDCE));
+      if (!running) wdtTimeout = sim.cycles + watchdogPeriod();
+    }
+    wdtcrAccessed = 0;
+  }
+  if (!(wdtConfig & ((1 << WDIE) | (1 << WDE)))) return;
+  while (sim.cycles >= wdtTimeout)
+  {
+    wdtFlag = 1;
+    wdtTimeout += watchdogPeriod();
+  }
+}
+
+static void checkEndOfInput(void)
+{
+  if (sim.cycles > endOfInput)
+  {
+    sim.exitReason = SIM_END_OF_INPUT;
+    longjmp(sim.exitJump, SIM_END_OF_INPUT);
+  }
+}
+
+static void updatePeripherals(void)
+{
+  updateTimer0();
+  updateTimer1();
+  updateEeprom();
+  updateAdc();
+  updatePinChange();
+  updateWatchdog();
+
+  // the PLL locks immediately
+  if (sim_reg[SIM_PLLCSR] & (1 << PLLE)) sim_reg[SIM_PLLCSR] |= (1 << PLOCK);
+}
+
+//***************************************************************************************
+// volatile uint8_t *sim_io(uint8_t reg)
+//
+// Access to a register with side effects. The simulated clock advances by
+// the cost of one polling loop iteration, then all peripherals are updated.
+//***************************************************************************************
+volatile uint8_t *sim_io(uint8_t reg)
+{
+  sim.cycles += sim.cyclesPerAccess;
+  checkEndOfInput();
+  updatePeripherals();
+
+  if (reg == SIM_PINB)
+  {
+    // the button is released as soon as the bootloader listens to the audio pin
+    sim.buttonPressed = 0;
+    sim_reg[SIM_PINB] = (PORTB & DDRB) | (digitalLevel() ? (1 << PB3) | (1 << PB4) : 0);
+  }
+  if (reg == SIM_GIFR)
+  {
+    sim_reg[SIM_GIFR] = 0x80 | (pinChangeFlag << PCIF);
+    gifrAccessed = 1;
+  }
+  if (reg == SIM_WDTCR)
+  {
+    sim_reg[SIM_WDTCR] = (1 << WDCE) | wdtConfig | (wdtFlag << WDIF);
+    wdtcrAccessed = 1;
+  }
+  return &sim_reg[reg];
+}
+
+//***************************************************************************************
+// void sim_sleep(void)
+//
+// sleep_cpu(): the clock advances in steps of 1us until an enabled pin change or
+// watchdog flag wakes the CPU up. The interrupts need not be enabled for this.
+// In power-down timer 0 stops and the clock needs sim.wakeupTime to start again.
+//***************************************************************************************
+void sim_sleep(void)
+{
+  uint8_t powerDown = (MCUCR & ((1 << SM1) | (1 << SM0))) == SLEEP_MODE_PWR_DOWN;
+  uint64_t start = sim.cycles;
+
+  if (!(MCUCR & (1 << SE))) return;
+
+  while (1)
+  {
+    sim.cycles += SECONDS(1e-6);
+    checkEndOfInput();
+    if (powerDown) timer0Updated = sim.cycles;
+    updatePeripherals();
+    if ((GIMSK & (1 << PCIE)) && pinChangeFlag) break;
+    if ((wdtConfig & (1 << WDIE)) && wdtFlag) break;
+  }
+  if (powerDown)
+  {
+    sim.cycles += SECONDS(sim.wakeupTime);
+    timer0Updated = sim.cycles;
+    sim.powerDownCycles += sim.cycles - start;
+  }
+  else sim.idleCycles += sim.cycles - start;
+}
+
+//***************************************************************************************
+// flash
+//***************************************************************************************
+void sim_page_fill(uint32_t address, uint16_t data)
+{
+  // the temporary page buffer can only be written once after it was cleared
+  sim.pageBuffer[(address % SIM_PAGESIZE) / 2] &= data;
+}
+
+// an EEPROM write blocks the programming of the flash, the SPM instruction is ignored
+static int eepromBlocksSpm(void)
+{
+  updateEeprom();
+  if (!(sim_reg[SIM_EECR] & (1 << EEPE))) return 0;
+  sim.spmBlocked++;
+  return 1;
+}
+
+void sim_page_erase(uint32_t address)
+{
+  if (eepromBlocksSpm()) return;
+  address = (address % SIM_FLASHSIZE) & ~(SIM_PAGESIZE - 1);
+  memset(&sim.flash[address], 0xFF, SIM_PAGESIZE);
+  sim.pageErases++;
+  sim.cycles += SECONDS(SIM_TWD_FLASH);
+  sim.spmCycles += SECONDS(SIM_TWD_FLASH);
+}
+
+void sim_page_write(uint32_t address)
+{
+  uint8_t n;
+
+  if (eepromBlocksSpm()) return;
+  address = (address % SIM_FLASHSIZE) & ~(SIM_PAGESIZE - 1);
+  for (n = 0; n < SIM_PAGESIZE / 2; n++)
+  {
+    // programming can only clear bits
+    sim.flash[address + 2 * n]     &= sim.pageBuffer[n] & 0xFF;
+    sim.flash[address + 2 * n + 1] &= sim.pageBuffer[n] >> 8;
+    sim.pageBuffer[n] = 0xFFFF;
+  }
+  sim.pageWrites++;
+  sim.cycles += SECONDS(SIM_TWD_FLASH);
+  sim.spmCycles += SECONDS(SIM_TWD_FLASH);
+}
+
+uint8_t sim_flash_read_byte(uint32_t address)
+{
+  return sim.flash[address % SIM_FLASHSIZE];
+}
+
+uint16_t sim_flash_read_word(uint32_t address)
+{
+  return sim_flash_read_byte(address) | (sim_flash_read_byte(address + 1) << 8);
+}
+
+void sim_flash_read(void *dest, uint32_t address, size_t n)
+{
+  uint8_t *d = dest;
+
+  while (n--) *d++ = sim_flash_read_byte(address++);
+}
+
+//***************************************************************************************
+// run control
+//***************************************************************************************
+void sim_start_application(uint32_t wordAddress)
+{
+  sim.applicationAddress = wordAddress;
+  sim.resetToAppCycles = sim.cycles;
+  sim.exitReason = SIM_APP_STARTED;
+  longjmp(sim.exitJump, SIM_APP_STARTED);
+}
+
+void sim_reset(void)
+{
+  memset(sim.flash, 0xFF, sizeof(sim.flash));
+  memset(sim.eeprom, 0xFF, sizeof(sim.eeprom));
+  memset(sim.pageBuffer, 0xFF, sizeof(sim.pageBuffer));
+  memset(sim_reg, 0, sizeof(sim_reg));
+  sim.cycles = 0;
+  sim.pinLevel = 0;
+  sim.exitReason = SIM_RUNNING;
+  timer0Updated = 0;
+  timer1Ticks = 0;
+  timer1Clock = 0;
+  TCCR1 = 0;
+  eepromReady = 0;
+  adcReady = 0;
+  PCMSK = 0;
+  pinChangeFlag = 0;
+  pinChangeMask = 0;
+  gifrAccessed = 0;
+  GIMSK = 0;
+  MCUCR = 0;
+  wdtConfig = 0;
+  wdtFlag = 0;
+  wdtcrAccessed = 0;
+  sim.idleCycles = 0;
+  sim.powerDownCycles = 0;
+  // with clock drift the end of the WAV is searched in steps of 1ms
+  endOfInput = 0;
+  while (playbackPosition((double)endOfInput / F_CPU) < sim.numSamples && endOfInput < SECONDS(3600))
+    endOfInput += SECONDS(1e-3);
+  endOfInput += SECONDS(sim.tailSeconds);
+}
+
+int sim_run(int (*firmwareMain)(void))
+{
+  if (setjmp(sim.exitJump) == 0)
+  {
+    firmwareMain();
+    sim.exitReason = SIM_END_OF_INPUT; // main() should never return
+  }
+  sim_finish();
+  return sim.exitReason;
+}
+
+// complete an EEPROM write which is still in progress when the simulation stops
+void sim_finish(void)
+{
+  updateEeprom();
+}
+
+double sim_seconds(void)
+{
+  return (double)sim.cycles / F_CPU;
+}
@@ -0,0 +1,128 @@
+/*
+  hostsim.h - firmware-in-the-loop simulation for TinyAudioBoot
+
+  The bootloader source is compiled for the host against the mock
+  avr/ headers in this directory. Every access to a time relevant
+  register ( PINB, TCNT0, TCNT1, PLLCSR, EECR, ADCSRA, ADCH, GIFR, WDTCR ) advances
+  the simulated CPU clock. PINB is driven from the samples of a WAV file,
+  TCNT0 counts at the prescaled CPU clock, TCNT1 at the prescaled CPU or
+  64MHz PLL clock and SPM writes land in an emulated flash array.
+  sleep_cpu() advances the clock until the pin change or the watchdog
+  flag wakes the CPU up, the time is counted per sleep mode.
+
+  Only register accesses cost time: plain C code between two accesses
+  is executed in zero simulated time. The cycles per access can be
+  adjusted to match the polling loops of the real target.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define SIM_FLASHSIZE    0x2000   // Attiny85: 8KB flash
+#define SIM_EEPROMSIZE   512      // Attiny85: 512 bytes EEPROM
+#define SIM_PAGESIZE     64       // Attiny85: SPM page size in bytes
+
+#define SIM_TWD_FLASH    4.5e-3   // page erase or page write time, CPU halted
+#define SIM_TWD_EEPROM   3.4e-3   // EEPROM erase and write time
+#define SIM_WDT_CLOCK    128000   // watchdog oscillator in Hz
+
+// reasons for leaving the simulated firmware
+#define SIM_RUNNING      0
+#define SIM_END_OF_INPUT 1        // WAV file and trailing silence consumed
+#define SIM_APP_STARTED  2        // firmware jumped to the application
+
+// register file indices of the registers with side effects
+#define SIM_PINB         0
+#define SIM_TCNT0        1
+#define SIM_EECR         2
+#define SIM_ADCSRA       3
+#define SIM_ADCH         4
+#define SIM_ADCL         5
+#define SIM_TCNT1        6
+#define SIM_PLLCSR       7
+#define SIM_GIFR         8
+#define SIM_WDTCR        9
+#define SIM_NUMREGS      10
+
+typedef struct
+{
+  // input signal
+  const float *samples;           // one channel, normalized to -1..1
+  uint32_t     numSamples;
+  uint32_t     sampleRate;
+  double       gain;              // volume scaling of the audio signal
+  double       threshold;         // digital switching level as fraction of VCC
+  double       hysteresis;        // schmitt trigger width as fraction of VCC
+  double       tailSeconds;       // silence appended after the WAV
+  double       clockError;        // relative deviation of the playback sample rate, e.g. 0.01 = 1% fast
+  double       clockDrift;        // change of the clock error per second
+  uint8_t      interpolate;       // linear interpolation between the samples, else each sample is held
+  uint8_t      buttonPressed;     // bootloader button held while the skip check runs
+  double       wakeupTime;        // clock start-up time after power-down, set by the fuses
+
+  // simulation state
+  uint64_t     cycles;            // CPU cycles since reset
+  uint8_t      cyclesPerAccess;   // cost of one register access in a polling loop
+  uint8_t      pinLevel;
+  jmp_buf      exitJump;
+  int          exitReason;
+  uint32_t     applicationAddress;
+
+  // emulated memories
+  uint8_t      flash[SIM_FLASHSIZE];
+  uint8_t      eeprom[SIM_EEPROMSIZE];
+  uint16_t     pageBuffer[SIM_PAGESIZE / 2];
+
+  // statistics
+  uint32_t     pageErases;
+  uint32_t     pageWrites;
+  uint32_t     eepromWrites;
+  uint32_t     spmBlocked;        // page erases and writes ignored during an EEPROM write
+  uint64_t     spmCycles;         // CPU cycles spent halted in SPM
+  uint64_t     resetToAppCycles;
+  uint64_t     idleCycles;        // CPU cycles asleep in idle mode
+  uint64_t     powerDownCycles;   // CPU cycles asleep in power-down mode, including the wake-up
+} sim_t;
+
+extern sim_t sim;
+
+// registers with side effects
+extern uint8_t sim_reg[SIM_NUMREGS];
+volatile uint8_t *sim_io(uint8_t reg);
+
+// plain registers
+extern volatile uint8_t  DDRB, PORTB, SREG, TCCR0A, TCCR0B, TCCR1, ADMUX, EEDR, SPMCSR, PCMSK, GIMSK, MCUCR;
+extern volatile uint16_t EEAR;
+
+// flash and EEPROM access
+void     sim_page_fill(uint32_t address, uint16_t data);
+void     sim_page_erase(uint32_t address);
+void     sim_page_write(uint32_t address);
+uint8_t  sim_flash_read_byte(uint32_t address);
+uint16_t sim_flash_read_word(uint32_t address);
+void     sim_flash_read(void *dest, uint32_t address, size_t n);
+
+// hooks called by the firmware when compiled with HOSTSIM
+void     sim_frame(const uint8_t *frame, uint16_t size, uint8_t ok);
+void     sim_start_application(uint32_t wordAddress);
+void     sim_sleep(void);
+
+// harness interface
+void     sim_reset(void);
+int      sim_run(int (*firmwareMain)(void));
+double   sim_seconds(void);
+void     sim_finish(void);
+
+#endif
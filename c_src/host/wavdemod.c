@@ -0,0 +1,262 @@
+/*
+  wavdemod.c - demodulate the frames of a WAV file without running the firmware
+
+  usage: wavdemod [options] file.wav [file.hex]
+
+  The samples are turned into the edges of the digital input pin ( switching
+  level and hysteresis like audioboot_sim ) and the frames are recovered with
+  the rules of receiveFrame() and receiveBlock() in TinyAudioBoot.c:
+  16 edges of the preamble, the sample delay is 3/4 of the mean of the last 8
+  bit times in timer ticks, the start bit is the first edge followed by a second
+  one within this delay and every data bit is sampled this delay after its middle edge.
+
+  For every frame the bit time and the margin of the sample point are reported.
+  The margin is the distance to the nearest edge in fractions of a bit, 25% for a
+  perfect signal. The airtime is split into gaps, synchronisation, headers and
+  payload. With a .hex file the decoded flash image is compared byte by byte.
+  Decoding ends with the first correct RUN or EXIT frame like the bootloader.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "hostsim.h"
+#include "AudioBootFrame.h"
+#include "wavio.h"
+#include "demod.h"
+
+static uint8_t image[SIM_FLASHSIZE];
+static uint8_t imageUsed[SIM_FLASHSIZE];
+static uint8_t verbose = 1;
+
+//***************************************************************************************
+// flash image: pages, compressed pages ( see decompressPages() ) and page blocks
+//***************************************************************************************
+static void writeImage(uint32_t address, const uint8_t *data, uint16_t length)
+{
+  while (length-- && address < SIM_FLASHSIZE)
+  {
+    image[address] = *data++;
+    imageUsed[address++] = 1;
+  }
+}
+
+static uint16_t decompress(uint32_t address, const uint8_t *src, uint8_t length)
+{
+  const uint8_t *end = src + length;
+  uint32_t a = address;
+
+  while (src < end)
+  {
+    uint8_t c = *src++;
+    uint16_t count = (c & 0x7F) + 1;
+
+    if (c & 0x80)
+    {
+      uint32_t from = a - (src[0] | (src[1] << 8));
+
+      count += 2;
+      src += 2;
+      while (count-- && a < SIM_FLASHSIZE && from < SIM_FLASHSIZE) writeImage(a++, &image[from++], 1);
+    }
+    else
+    {
+      writeImage(a, src, count);
+      src += count;
+      a += count;
+    }
+  }
+  return a - address;
+}
+
+static int compareImage(const char *name)
+{
+  uint8_t hex[SIM_FLASHSIZE], used[SIM_FLASHSIZE];
+  uint32_t a, size = 0, bytes = 0, differ = 0;
+
+  memset(used, 0, sizeof(used));
+  if (!readHex(name, hex, used, &size)) return 2;
+  for (a = 0; a < size; a++)
+  {
+    if (!used[a]) continue;
+    bytes++;
+    if (!imageUsed[a] || image[a] != hex[a]) differ++;
+  }
+  if (differ == 0) printf("image         : byte-exact, %u bytes of %s\n", bytes, name);
+  else printf("image         : %u of %u bytes differ from %s\n", differ, bytes, name);
+  return differ != 0;
+}
+
+static const char *crcText(int ok, const frame_t *f)
+{
+  if (ok == 2) return "legacy";
+  if (ok) return "ok";
+  if ((f->data[CRCLOW] | (f->data[CRCHIGH] << 8)) == LEGACYCRC) return "legacy";
+  return "BAD";
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: wavdemod [options] file.wav [file.hex]\n"
+          "  file.wav       - reads a streamed WAV file from stdin\n"
+          "  -g gain        volume scaling of the signal ( default 1.0 )\n"
+          "  -t threshold   digital switching level in fractions of VCC ( default 0.5 )\n"
+          "  -y hysteresis  schmitt trigger width in fractions of VCC ( default 0.0 )\n"
+          "  -C channel     WAV channel ( default 0 = left )\n"
+          "  -H us          time constant of the input high pass ( default 0 = DC coupled )\n"
+          "  -F             frames with FEC bytes ( USE_FEC )\n"
+          "  -T             16 bit timer at 16MHz ( USE_TIMER1 ) instead of timer 0\n"
+          "  -S             keep the bit time of the first frame ( USE_SHORTSYNC )\n"
+          "  -l             accept the fixed checksum of old generators ( 0x55AA )\n"
+          "  -b             one summary line for benchmark tables\n"
+          "  -q             do not list the frames\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t numSamples = 0, sampleRate = 0;
+  uint8_t channel = 0, legacy = 0, bench = 0;
+  double gain = 1.0, threshold = 0.5, hysteresis = 0.0, highPassTime = 0;
+  double gapTime = 0, syncTime = 0, headerTime = 0, payloadTime = 0, fecTime = 0, end = 0, minMargin = 1;
+  uint32_t ok = 0, failed = 0, payload = 0, numFrames = 0;
+  int opt, result = 0, finished = 0;
+  float *samples;
+  demod_t e;
+  frame_t f;
+
+  demodInit(&e);
+  while ((opt = getopt(argc, argv, "g:t:y:C:H:FTSlbq")) != -1)
+  {
+    switch (opt)
+    {
+      case 'g': gain = atof(optarg); break;
+      case 't': threshold = atof(optarg); break;
+      case 'y': hysteresis = atof(optarg); break;
+      case 'C': channel = atoi(optarg); break;
+      case 'H': highPassTime = atof(optarg) * 1e-6; break;
+      case 'F': e.fecSize = FECLANES + 1; break;
+      case 'T': e.tickRate = 16e6; e.timerMask = 0xFFFF; break;
+      case 'S': e.shortSync = 1; break;
+      case 'l': legacy = 1; break;
+      case 'b': bench = 1; verbose = 0; break;
+      case 'q': verbose = 0; break;
+      default: usage();
+    }
+  }
+  if (optind >= argc) usage();
+
+  samples = readWav(argv[optind], channel, &numSamples, &sampleRate);
+  if (!samples) return 2;
+  if (highPassTime > 0) highPass(samples, numSamples, sampleRate, highPassTime);
+  demodEdges(&e, samples, numSamples, sampleRate, gain, threshold, hysteresis);
+
+  while (!finished)
+  {
+    uint16_t crc, length, page, n;
+    double frameEnd;
+    int frameOk = demodFrame(&e, &f, &crc);
+
+    if (frameOk < 0) break;
+    if (!frameOk && legacy && (f.data[CRCLOW] | (f.data[CRCHIGH] << 8)) == LEGACYCRC) frameOk = 2;
+    numFrames++;
+    page = f.data[PAGEINDEXLOW] | (f.data[PAGEINDEXHIGH] << 8);
+    length = f.data[LENGTHLOW] | (f.data[LENGTHHIGH] << 8);
+    n = 0;
+
+    gapTime += f.start - end;
+    syncTime += f.startBit - f.start;
+    headerTime += DATAPAGESTART * 8 * f.bitTime;
+    fecTime += e.fecSize * 8 * f.bitTime;
+    if (f.minMargin < minMargin) minMargin = f.minMargin;
+
+    if (frameOk)
+    {
+      switch (f.data[COMMAND])
+      {
+        case PROGCOMMAND:
+          writeImage((uint32_t)page * PAGESIZE, f.data + DATAPAGESTART, PAGESIZE);
+          n = PAGESIZE;
+          break;
+        case EEPROMCOMMAND:
+          n = length < PAGESIZE ? length : PAGESIZE;
+          break;
+        case COMPRESSEDCOMMAND:
+          n = length < PAGESIZE ? decompress((uint32_t)page * PAGESIZE, f.data + DATAPAGESTART, length) : 0;
+          break;
+        case MULTIPAGECOMMAND:
+          for (; length >= PAGESIZE; length -= PAGESIZE, page++)
+          {
+            int blockOk = demodBlock(&e, &f, CRCLOW, PAGESIZE + DATAPAGESTART, &crc);
+            if (blockOk <= 0) { frameOk = 0; break; }
+            writeImage((uint32_t)page * PAGESIZE, f.data + DATAPAGESTART, PAGESIZE);
+            headerTime += 2 * 8 * f.bitTime;
+            fecTime += e.fecSize * 8 * f.bitTime;
+            n += PAGESIZE;
+          }
+          if (f.minMargin < minMargin) minMargin = f.minMargin;
+          break;
+        case RUNCOMMAND:
+        case EXITCOMMAND:
+          finished = 1;
+          break;
+      }
+    }
+    frameEnd = f.end;
+    payload += n;
+    payloadTime += n * 8 * f.bitTime;
+    if (frameOk) ok++;
+    else failed++;
+
+    if (verbose)
+    {
+      printf("frame %4u  t=%8.4fs  cmd=%u page=%-4u len=%-5u crc=%-6s bit=%6.1fus margin=%3.0f%% sync=%5.1fms\n",
+             numFrames, f.start, f.data[COMMAND], f.data[PAGEINDEXLOW] | (f.data[PAGEINDEXHIGH] << 8),
+             f.data[LENGTHLOW] | (f.data[LENGTHHIGH] << 8),
+             crcText(frameOk, &f), f.bitTime * 1e6, 100 * f.minMargin,
+             1000 * (f.startBit - f.start));
+    }
+    end = frameEnd;
+  }
+  if (bench)
+  {
+    const char *status = "-";
+
+    if (optind + 1 < argc)
+    {
+      uint8_t hex[SIM_FLASHSIZE], used[SIM_FLASHSIZE];
+      uint32_t a, size = 0, differ = 0;
+
+      memset(used, 0, sizeof(used));
+      if (!readHex(argv[optind + 1], hex, used, &size)) return 2;
+      for (a = 0; a < size; a++) if (used[a] && (!imageUsed[a] || image[a] != hex[a])) differ++;
+      status = differ ? "differs" : "exact";
+      result = differ != 0;
+    }
+    printf("%4u ok %3u failed  %7.3f s  %6.0f bit/s  margin %3.0f%%  image %-7s  %s\n",
+           ok, failed, end, end > 0 ? payload * 8 / end : 0, numFrames ? 100 * minMargin : 0, status, argv[optind]);
+    return result || failed || !finished;
+  }
+
+  if (e.overflow) printf("receiver      : the bit time is too long for the timer, the bootloader hangs\n");
+  printf("signal        : %s, %u Hz, %.3f s\n", argv[optind], sampleRate, (double)numSamples / sampleRate);
+  printf("frames        : %u ok, %u failed%s\n", ok, failed, finished ? "" : ", no RUN or EXIT frame");
+  printf("airtime       : %.3f s to the end of the last frame\n", end);
+  if (end > 0)
+  {
+    double other = end - gapTime - syncTime - headerTime - payloadTime - fecTime;
+    printf("overhead      : gaps %.3f s, sync %.3f s, headers %.3f s, fec %.3f s, padding %.3f s\n",
+           gapTime, syncTime, headerTime, fecTime, other);
+    printf("throughput    : %u payload bytes in %.3f s = %.0f bit/s, %.0f%% of the airtime\n",
+           payload, end, payload * 8 / end, 100 * payloadTime / end);
+  }
+  if (numFrames) printf("margin        : %.0f%% of a bit at the worst sample point ( 25%% ideal )\n", 100 * minMargin);
+  if (optind + 1 < argc) result = compareImage(argv[optind + 1]);
+  return result || failed || !finished;
+}
@@ -0,0 +1,193 @@
+/*
+  wavio.c - WAV and Intel HEX input of the host tools, see wavio.h
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+#include "wavio.h"
+
+//***************************************************************************************
+// WAV file: PCM 8/16 bit, any number of channels, one channel is used
+//***************************************************************************************
+static uint32_t le(const uint8_t *p, uint8_t n)
+{
+  uint32_t v = 0;
+
+  while (n--) v = (v << 8) | p[n];
+  return v;
+}
+
+// skip bytes without seeking, the WAV file may be a pipe
+static void skip(FILE *fp, uint32_t n)
+{
+  while (n-- && fgetc(fp) != EOF);
+}
+
+// the data of a streamed WAV file has no known size ( 0xFFFFFFFF ), it ends with the file
+static uint8_t *readData(FILE *fp, uint32_t *size)
+{
+  uint32_t capacity = 1 << 20, n = 0;
+  uint8_t *raw = malloc(capacity);
+
+  while (raw && n < *size)
+  {
+    uint32_t want = *size - n < capacity - n ? *size - n : capacity - n;
+    uint32_t got = fread(raw + n, 1, want, fp);
+
+    n += got;
+    if (got < want) break;
+    if (n == capacity && n < *size)
+    {
+      capacity *= 2;
+      raw = realloc(raw, capacity);
+    }
+  }
+  *size = n;
+  return raw;
+}
+
+float *readWav(const char *name, uint8_t channel, uint32_t *numSamples, uint32_t *sampleRate)
+{
+  FILE *fp = strcmp(name, "-") ? fopen(name, "rb") : stdin;
+  uint8_t hdr[12], chunk[8], fmt[16];
+  uint16_t channels = 0, bits = 0;
+  float *samples = NULL;
+
+  if (!fp) { perror(name); return NULL; }
+
+  if (fread(hdr, 1, 12, fp) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+  {
+    fprintf(stderr, "%s: not a RIFF/WAVE file\n", name);
+    fclose(fp);
+    return NULL;
+  }
+
+  while (fread(chunk, 1, 8, fp) == 8)
+  {
+    uint32_t size = le(chunk + 4, 4);
+
+    if (!memcmp(chunk, "fmt ", 4))
+    {
+      if (size < 16 || fread(fmt, 1, 16, fp) != 16) break;
+      channels = le(fmt + 2, 2);
+      *sampleRate = le(fmt + 4, 4);
+      bits = le(fmt + 14, 2);
+      skip(fp, size - 16 + (size & 1));
+    }
+    else if (!memcmp(chunk, "data", 4))
+    {
+      uint32_t bytesPerFrame = channels * bits / 8;
+      uint8_t *raw;
+      uint32_t n;
+
+      if (le(fmt, 2) != 1 || (bits != 8 && bits != 16) || channel >= channels) break;
+
+      raw = readData(fp, &size);
+      if (!raw) break;
+      *numSamples = size / bytesPerFrame;
+      samples = malloc(*numSamples * sizeof(float) + 1);
+
+      for (n = 0; n < *numSamples; n++)
+      {
+        const uint8_t *s = raw + n * bytesPerFrame + channel * bits / 8;
+
+        if (bits == 8) samples[n] = (s[0] - 128) / 128.0f;
+        else           samples[n] = (int16_t)le(s, 2) / 32768.0f;
+      }
+      free(raw);
+      break;
+    }
+    else skip(fp, size + (size & 1));
+  }
+  if (fp != stdin) fclose(fp);
+
+  if (!samples) fprintf(stderr, "%s: unsupported WAV format\n", name);
+  return samples;
+}
+
+//***************************************************************************************
+// input network
+//
+// The coupling capacitor and the bias divider form a first order high pass
+// with the time constant C*(R1||R2), 100nF*5k = 500us for the documented circuit.
+//***************************************************************************************
+void highPass(float *samples, uint32_t numSamples, uint32_t sampleRate, double seconds)
+{
+  double a = seconds / (seconds + 1.0 / sampleRate);
+  double x, lastX = 0, y = 0;
+  uint32_t n;
+
+  for (n = 0; n < numSamples; n++)
+  {
+    x = samples[n];
+    y = a * (y + x - lastX);
+    lastX = x;
+    samples[n] = (float)y;
+  }
+}
+
+//***************************************************************************************
+// Intel HEX file
+//***************************************************************************************
+int readHex(const char *name, uint8_t *data, uint8_t *used, uint32_t *size)
+{
+  FILE *fp = fopen(name, "r");
+  char line[600];
+  uint32_t base = 0;
+
+  if (!fp) { perror(name); return 0; }
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    uint8_t rec[260];
+    uint8_t sum = 0;
+    int n, len;
+
+    if (line[0] != ':') continue;
+    len = (strlen(line) - 1) / 2;
+    for (n = 0; n < len && n < (int)sizeof(rec); n++)
+    {
+      unsigned v;
+      if (sscanf(line + 1 + 2 * n, "%2x", &v) != 1) break;
+      rec[n] = v;
+      sum += v;
+    }
+    if (n < 5 || n < rec[0] + 5 || sum != 0)
+    {
+      fprintf(stderr, "%s: bad record %s", name, line);
+      fclose(fp);
+      return 0;
+    }
+
+    switch (rec[3])
+    {
+      case 0: // data
+        for (n = 0; n < rec[0]; n++)
+        {
+          uint32_t a = base + (rec[1] << 8) + rec[2] + n;
+          if (a >= SIM_FLASHSIZE) continue;
+          data[a] = rec[4 + n];
+          used[a] = 1;
+          if (a + 1 > *size) *size = a + 1;
+        }
+        break;
+      case 1: // end of file
+        fclose(fp);
+        return 1;
+      case 2: // extended segment address
+        base = ((rec[4] << 8) + rec[5]) * 16;
+        break;
+      case 4: // extended linear address
+        base = ((rec[4] << 8) + rec[5]) << 16;
+        break;
+    }
+  }
+  fclose(fp);
+  return 1;
+}
@@ -0,0 +1,31 @@
+/*
+  wavio.h - WAV and Intel HEX input of the host tools ( audioboot_sim, wavdemod, channelsim )
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+#ifndef WAVIO_H
+#define WAVIO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// one channel of a PCM WAV file as samples from -1 to 1, name "-" reads stdin
+float *readWav(const char *name, uint8_t channel, uint32_t *numSamples, uint32_t *sampleRate);
+
+// high pass of the input network ( coupling capacitor and bias divider ), time constant in seconds
+void highPass(float *samples, uint32_t numSamples, uint32_t sampleRate, double seconds);
+
+// Intel HEX file into data[ SIM_FLASHSIZE ], used[] marks the bytes of the file, size is the end of the data
+int readHex(const char *name, uint8_t *data, uint8_t *used, uint32_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,11 +19,15 @@ import java.awt.Color;
 import java.awt.event.ActionEvent;
 import java.awt.event.ActionListener;
 import java.io.File;
+import java.io.FileDescriptor;
+import java.io.FileOutputStream;
 import java.io.IOException;
+import java.io.OutputStream;
 
 import javax.swing.BoxLayout;
 import javax.swing.JButton;
 import javax.swing.JCheckBox;
+import javax.swing.JComboBox;
 import javax.swing.JFileChooser;
 import javax.swing.JFrame;
 import javax.swing.JPanel;
@@ -46,12 +50,30 @@ public class Main_WavBootLoader extends JPanel{
 	public JButton   button_ouputWavFile;
 	public JButton   button_writeWav;
 	public JCheckBox speedCheckBox;
+	public JCheckBox fecCheckBox;
+	public JCheckBox compressionCheckBox;
+	public JCheckBox symbolCheckBox;
+	public JCheckBox preEmphasisCheckBox;
+	public JCheckBox eepromQueueCheckBox;
+	public JCheckBox resumeCheckBox;
+	public JCheckBox shortSyncCheckBox;
+	public JComboBox sampleRateBox;
+	public JComboBox bitRateBox;
 	public JTextArea testText;
 	public Model_ProgrammParameters setupData;
 	
 	public void showMainWindow()
 	{
 		speedCheckBox = new JCheckBox("slow");
+		fecCheckBox = new JCheckBox("fec");
+		compressionCheckBox = new JCheckBox("compress");
+		symbolCheckBox = new JCheckBox("symbols");
+		preEmphasisCheckBox = new JCheckBox("pre-emphasis");
+		eepromQueueCheckBox = new JCheckBox("eeprom queue");
+		resumeCheckBox = new JCheckBox("resumable");
+		shortSyncCheckBox = new JCheckBox("short sync");
+		sampleRateBox = new JComboBox(new String[] { "44100", "48000", "96000", "192000" });
+		bitRateBox = new JComboBox(new String[] { "standard bit rate", "22050", "44100" });
 
 		frame= new JFrame(); // create main window
 		frame.setDefaultCloseOperation(JFrame.EXIT_ON_CLOSE);
@@ -92,6 +114,15 @@ public class Main_WavBootLoader extends JPanel{
 		frame.add(scrollText,BorderLayout.CENTER);
 
         panel.add(speedCheckBox);
+        panel.add(fecCheckBox);
+        panel.add(compressionCheckBox);
+        panel.add(symbolCheckBox);
+        panel.add(preEmphasisCheckBox);
+        panel.add(eepromQueueCheckBox);
+        panel.add(resumeCheckBox);
+        panel.add(shortSyncCheckBox);
+        panel.add(sampleRateBox);
+        panel.add(bitRateBox);
         
 		frame.setSize(640,480);
 		frame.setVisible(true);
@@ -117,6 +148,14 @@ public class Main_WavBootLoader extends JPanel{
 	        return fileName.substring(0, index);
 	    }
 	}
+	// the eep file with the EEPROM data of a hex file, null if there is none
+	public static File eepFileOf(File hexFile)
+	{
+		File eep=new File(hexFile.getParentFile(),getBaseName(hexFile.getName())+".eep");
+		if(eep.exists()) return eep;
+		return null;
+	}
+	
 	class inputHexFile_ButtonListener implements ActionListener
 	{
 	
@@ -138,11 +177,11 @@ public class Main_WavBootLoader extends JPanel{
         	{
         		@Override public boolean accept ( File f)
         		{
-        			return f.isDirectory() || f.getName().toLowerCase().endsWith(".hex");
+        			return f.isDirectory() || f.getName().toLowerCase().endsWith(".hex") || f.getName().toLowerCase().endsWith(".eep");
         		}
         		@Override public String getDescription()
         		{
-        			return "Hex-Files";
+        			return "Hex-Files, EEPROM-Files";
         		}	        		
         	});
         	
@@ -151,9 +190,22 @@ public class Main_WavBootLoader extends JPanel{
         	{
         		File file=fc.getSelectedFile();
     			
+        		if(file.getName().toLowerCase().endsWith(".eep")) // EEPROM data for the selected hex file
+        		{
+        			testText.append("\nselected eep-file:\n");
+        			testText.append(file.getAbsolutePath());
+        			setupData.setInputEepFile(file);
+        			return;
+        		}
         		testText.append("selected hexfile:\n");
         		testText.append(file.getAbsolutePath());
         		setupData.setInputHexFile(file);
+        		setupData.setInputEepFile(eepFileOf(file));
+        		if(setupData.getInputEepFile()!=null)
+        		{
+        			testText.append("\nwith eep-file:\n");
+        			testText.append(setupData.getInputEepFile().getAbsolutePath());
+        		}
         		
         		String outputFileName=getBaseName( file.getName() )+".wav";
         		System.out.println("output file name:"+outputFileName);
@@ -172,7 +224,16 @@ public class Main_WavBootLoader extends JPanel{
 			{
 				WavCodeGenerator wg=new WavCodeGenerator();
 				wg.setSignalSpeed(!speedCheckBox.isSelected());
-				wg.convertHex2Wav(setupData.getInputHexFile() ,setupData.getOutputWavFile());
+				wg.setFec(fecCheckBox.isSelected());
+				wg.setCompression(compressionCheckBox.isSelected());
+				wg.setSymbolMode(symbolCheckBox.isSelected());
+				wg.setEepromQueue(eepromQueueCheckBox.isSelected());
+				if(resumeCheckBox.isSelected()) wg.setChapterPages(16);
+				wg.setShortSync(shortSyncCheckBox.isSelected());
+				if(preEmphasisCheckBox.isSelected()) wg.setPreEmphasis(5e3,100e-9); // 100nF into 10k/10k
+				wg.setSampleRate(Integer.parseInt((String)sampleRateBox.getSelectedItem()));
+				if(bitRateBox.getSelectedIndex()>0) wg.setBitRate(Double.parseDouble((String)bitRateBox.getSelectedItem()));
+				wg.convertHex2Wav(setupData.getInputHexFile() ,setupData.getInputEepFile() ,setupData.getOutputWavFile());
 			} catch (Exception e1) {
 				// TODO Auto-generated catch block
 				e1.printStackTrace();
@@ -195,7 +256,9 @@ public class Main_WavBootLoader extends JPanel{
 			WavCodeGenerator wg=new WavCodeGenerator();
 
 			wg.setSignalSpeed(true);
-			wg.convertHex2Wav(setupData.getInputHexFile() ,setupData.getOutputWavFile());
+			if(setupData.getRightHexFile()!=null) wg.convertHex2StereoWav(setupData.getInputHexFile() ,setupData.getInputEepFile() ,
+					setupData.getRightHexFile() ,eepFileOf(setupData.getRightHexFile()) ,setupData.getOutputWavFile());
+			else wg.convertHex2Wav(setupData.getInputHexFile() ,setupData.getInputEepFile() ,setupData.getOutputWavFile());
 		} catch (Exception e1) {
 			// TODO Auto-generated catch block
 			e1.printStackTrace();
@@ -206,30 +269,94 @@ public class Main_WavBootLoader extends JPanel{
     	new AePlayWave(setupData.getOutputWavFile().toString()).start();
 	}
 	
+	// no wav file: the signal goes to pcmStream while it is generated, null: sound card
+	public void convertAndStreamWav(OutputStream pcmStream)
+	{
+		System.out.println("\nstreaming hex\n");
+
+		try {
+			WavCodeGenerator wg=new WavCodeGenerator();
+
+			wg.setSignalSpeed(true);
+			if(pcmStream!=null) wg.convertHex2Stream(setupData.getInputHexFile() ,setupData.getInputEepFile() ,pcmStream,true);
+			else wg.playHex(setupData.getInputHexFile() ,setupData.getInputEepFile());
+			if(pcmStream!=null) pcmStream.close();
+		} catch (Exception e1) {
+			e1.printStackTrace();
+		}
+		System.out.println("done\n");
+	}
+	
 	public static void main(String[] args) 
 	{
+		OutputStream pcmStream=null;	// -stdout or -pipe file: wav stream of unknown length
+		boolean play=false;				// -play: sound card without a wav file
+		File rightHexFile=null;			// -right file.hex: stereo wav with this image on the right channel
+		int first=0;					// first file argument after the options
+		
+		try
+		{
+			for(;first<args.length && args[first].startsWith("-");first++)
+			{
+				if(args[first].equals("-stdout"))
+				{
+					pcmStream=new FileOutputStream(FileDescriptor.out);
+					System.setOut(System.err); // the messages must not mix with the signal
+				}
+				else if(args[first].equals("-pipe") && first+1<args.length) pcmStream=new FileOutputStream(args[++first]);
+				else if(args[first].equals("-play")) play=true;
+				else if(args[first].equals("-right") && first+1<args.length) rightHexFile=new File(args[++first]);
+				else System.err.println("unknown option: "+args[first]);
+			}
+		}
+		catch(IOException e)
+		{
+			System.err.println(e);
+			return;
+		}
+		
     	Main_WavBootLoader w=new Main_WavBootLoader();
     	
     	String property = "java.io.tmpdir";
     	String tempDir = System.getProperty(property);
 
-    	System.out.println("convert hex-file to speaker sound : java -jar AudioBoot.jar testFile.hex");
+    	System.out.println("convert hex-file to speaker sound : java -jar AudioBoot.jar [-stdout|-pipe file|-play] testFile.hex [testFile.eep]");
+    	System.out.println("two devices, one per channel               : java -jar AudioBoot.jar -right right.hex left.hex [left.eep]");
 		
-    	if(args.length>0) // command line arguments: run in shell, do not show window
+    	if(args.length>first) // command line arguments: run in shell, do not show window
         {
         	System.out.println("there are "+args.length+"command-line arguments.");
         	for(int i=0;i<args.length;i++) System.out.println("args["+i+"]:"+args[i]);
-    		File file=new File(args[0]);
+    		File file=new File(args[first]);
     		String outputFileName=getBaseName( file.getName() )+".wav";
 
     	    String absolutePath = file.getAbsolutePath();
     	    String filePath = absolutePath.substring(0,absolutePath.lastIndexOf(File.separator));
 
-        	w.setupData.setInputHexFile(file); 
+        	if(file.getName().toLowerCase().endsWith(".eep")) // only EEPROM data
+        	{
+        		w.setupData.setInputHexFile(null);
+        		w.setupData.setInputEepFile(file);
+        	}
+        	else
+        	{
+        		w.setupData.setInputHexFile(file);
+        		if(args.length>first+1) w.setupData.setInputEepFile(new File(args[first+1]));
+        		else w.setupData.setInputEepFile(eepFileOf(file));
+        	}
 
         	w.setupData.setOutputWavFile(new File(filePath + File.separator + outputFileName));   	
+        	w.setupData.setRightHexFile(rightHexFile);
+        	if(rightHexFile!=null && (pcmStream!=null || play))
+        	{
+        		System.err.println("-right: the stereo signal is only written into a wav file");
+        		pcmStream=null;
+        		play=false;
+        	}
   	
-        	w.convertAndPlayWav();
+        	if(pcmStream!=null) w.convertAndStreamWav(pcmStream);
+        	else if(play) w.convertAndStreamWav(null);
+        	else w.convertAndPlayWav();
         }
         else // no command line available arguments, run GUI
         {
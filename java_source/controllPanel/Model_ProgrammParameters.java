@@ -19,6 +19,8 @@ public class Model_ProgrammParameters
 {
 	private File inputHexFile;
 	private File outputWavFile;
+	private File inputEepFile;	// EEPROM data, null: no EEPROM frames
+	private File rightHexFile;	// image on the right channel of a stereo wav file, null: the same signal on both channels
 	private int  data[];
 	
 	public Model_ProgrammParameters()
@@ -47,6 +49,22 @@ public class Model_ProgrammParameters
 		return inputHexFile;
 	}
 	
+	public void setInputEepFile(File inputEepFile) {
+		this.inputEepFile = inputEepFile;
+	}
+	
+	public File getInputEepFile() {
+		return inputEepFile;
+	}
+	
+	public void setRightHexFile(File rightHexFile) {
+		this.rightHexFile = rightHexFile;
+	}
+	
+	public File getRightHexFile() {
+		return rightHexFile;
+	}
+	
 	public void setData(int data[]) {
 		this.data = data;
 	}
@@ -15,14 +15,15 @@ package wavCreator;
 
 public class BootFrame {
 
-	/*
-	   	#define COMMAND         0
-		#define PAGEINDEXLOW 	1  // page address lower part
-		#define PAGEINDEXHIGH 	2  // page address higher part
-		#define CRCLOW          3  // checksum lower part
-		#define CRCHIGH 		4  // checksum higher part
-		#define DATAPAGESTART   5  // start of data
-		#define FRAMESIZE       (DATAPAGESTART+128) // size of the data block to be received
+	/* frame layout and commands as defined in c_src/AudioBootFrame.h
+		#define COMMAND         0
+		#define PAGEINDEXLOW    1  // page address lower part
+		#define PAGEINDEXHIGH   2  // page address higher part
+		#define LENGTHLOW       3
+		#define LENGTHHIGH      4
+		#define CRCLOW          5  // checksum lower part
+		#define CRCHIGH         6  // checksum higher part
+		#define DATAPAGESTART   7  // start of data, PAGESIZE ( 64 ) bytes, then the FEC data
 	 */
 	
 	private int command;
@@ -32,10 +33,32 @@ public class BootFrame {
 	private int pageSize  = 64;
 	private int frameSize = pageStart + pageSize;
 	private int totalLength;
+	
+	// forward error correction, see fecCorrect() in TinyAudioBoot.c
+	// the bootloader has to be compiled with USE_FEC
+	public static final int FECLANES = 4;
+	
+	// 0 bits before the start bit after the first frame, the bootloader has to be compiled with USE_SHORTSYNC
+	public static final int SHORTSYNCBITS = 8;
+
+	// amplitude of the 4 level symbols in 1/10 of the full amplitude, SYMBOLLEVEL(n) in AudioBootFrame.h
+	public static int symbolLevel(int n)
+	{
+		return 4+2*n;
+	}
+
+	private boolean fec = false;
 
 	//private double silenceBetweenPages=2; // 2 seconds for debugging purposes silence in seconds
 	private double silenceBetweenPages=0.02; // silence in seconds
 	
+	// the Attiny85 has no read while write section: the CPU is halted while a page is
+	// erased ( 4.5ms ) and written ( 4.5ms ), the receiver misses all edges in this time
+	private double programmingTime=0.0095; // page erase + page write + margin in seconds
+	
+	// the bootloader writes the bytes of an EEPROM frame before it listens again
+	private double eepromWriteTime=0.0035; // EEPROM erase and write of one byte + margin in seconds
+	
 	public BootFrame()
 	{
 		command=0;
@@ -59,6 +82,44 @@ public class BootFrame {
 		command=1;
 	}	
 	
+	// totalLength bytes to the EEPROM address pageIndex*pageSize
+	public void setEepromCommand()
+	{
+		command=4;
+	}
+	
+	// leave the bootloader and start the unchanged program, ends a wav file with only EEPROM data
+	public void setExitCommand()
+	{
+		command=5;
+	}
+	
+	// LZ compressed data of several pages, see LzCompressor
+	public void setCompressedCommand()
+	{
+		command=6;
+	}
+	
+	// header of a multi page frame, the pages follow as blocks, see makePageBlock()
+	public void setMultiPageCommand()
+	{
+		command=7;
+	}
+	
+	// the following frames are sent as 4 level symbols, see HexToSignal.symbolCoding()
+	// the bootloader has to be compiled with USE_ADC_SYMBOLS
+	public void setSymbolModeCommand()
+	{
+		command=8;
+	}
+	
+	// start of a chapter: pageIndex is the image id, totalLength the image length,
+	// the data the first word of the image. The bootloader has to be compiled with USE_RESUME
+	public void setImageCommand()
+	{
+		command=9;
+	}
+	
 	public int[] addFrameParameters(int data[])
 	{
 		data[0]=command;
@@ -68,17 +129,95 @@ public class BootFrame {
 		data[3]=totalLength&0xFF;
 		data[4]=(totalLength>>8)&0xFF;
 
+		crc=calculateCrc(data);
 		data[5]=crc&0xFF;
 		data[6]=(crc>>8)&0xFF;		
+		if(fec) addFec(data,pageStart+getDataSize());
 		return data;
 	}
 	
+	/* one page of a multi page frame: checksum and data, received by the
+	 * bootloader at the position of the checksum in a normal frame
+	 */
+	public int[] makePageBlock(int page[])
+	{
+		int[] block=new int[2+pageSize+(fec?FECLANES+1:0)];
+		int c=0xFFFF;
+		for(int n=0;n<pageSize;n++)
+		{
+			block[2+n]=page[n];
+			c=crcCcittUpdate(c,page[n]);
+		}
+		block[0]=c&0xFF;
+		block[1]=(c>>8)&0xFF;
+		if(fec) addFec(block,2+pageSize);
+		return block;
+	}
+	
+	/* the frame bits are interleaved into FECLANES lanes, bit n belongs to lane n%FECLANES
+	 * at position n/FECLANES+1. For every lane the xor of the positions of all 1 bits
+	 * is sent, followed by one byte with the parity of each lane.
+	 */
+	public void addFec(int data[], int protectedBytes)
+	{
+		int[] syndrome=new int[FECLANES];
+		int parity=0;
+		
+		for(int n=0;n<protectedBytes*8;n++)
+		{
+			if(((data[n/8]<<(n%8))&0x80)!=0)
+			{
+				syndrome[n%FECLANES]^=n/FECLANES+1;
+				parity^=1<<(n%FECLANES);
+			}
+		}
+		for(int k=0;k<FECLANES;k++) data[protectedBytes+k]=syndrome[k];
+		data[protectedBytes+FECLANES]=parity;
+	}
+	
+	/* crc16 as calculated by _crc_ccitt_update() of the avr-libc
+	 * polynomial 0x8408, start value 0xFFFF
+	 */
+	public static int crcCcittUpdate(int crc, int data)
+	{
+		data^=crc&0xFF;
+		data^=(data<<4)&0xFF;
+		return (((data<<8)|((crc>>8)&0xFF))^(data>>4)^(data<<3))&0xFFFF;
+	}
+	
+	// checksum over the whole frame without the checksum bytes 5 and 6 and the FEC data
+	public int calculateCrc(int data[])
+	{
+		int c=0xFFFF;
+		for(int n=0;n<pageStart+getDataSize();n++)
+		{
+			if(n!=5 && n!=6) c=crcCcittUpdate(c,data[n]);
+		}
+		return c;
+	}
+	
 	public void setFrameSize(int frameSize) {
 		this.frameSize = frameSize;
 	}
 	
+	// size of the frame including the FEC data
 	public int getFrameSize() {
-		return frameSize;
+		return pageStart + getDataSize() + (fec ? FECLANES + 1 : 0);
+	}
+	
+	// compressed frames end after the data ( totalLength bytes ), multi page frames after the header
+	public int getDataSize() {
+		if(command==6) return totalLength;
+		if(command==7) return 0;
+		return frameSize - pageStart;
+	}
+	
+	public void setFec(boolean fec) {
+		this.fec = fec;
+	}
+	
+	public boolean getFec() {
+		return fec;
 	}
 	
 	public void setCommand(int command) {
@@ -136,4 +275,20 @@ public class BootFrame {
 	public double getSilenceBetweenPages() {
 		return silenceBetweenPages;
 	}
+	
+	public void setProgrammingTime(double programmingTime) {
+		this.programmingTime = programmingTime;
+	}
+	
+	public double getProgrammingTime() {
+		return programmingTime;
+	}
+	
+	public void setEepromWriteTime(double eepromWriteTime) {
+		this.eepromWriteTime = eepromWriteTime;
+	}
+	
+	public double getEepromWriteTime() {
+		return eepromWriteTime;
+	}
 }
@@ -0,0 +1,135 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	benchmark of the wav generation: the old path, which copied the whole signal
+	for every appended frame and saved the finished array, against the streaming
+	path of convertHex2Wav(), which encodes the frames straight into the file
+
+	usage: java wavCreator.GeneratorBenchmark [directory or hex file] ...
+	       default: the hex files in ../build and ../build/old
+
+	Every hex file is converted at 44.1kHz and 192kHz. The time is the best of
+	three runs, the heap is the peak of all heap pools during one run.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import hexTools.IntelHexFormat;
+
+import java.io.File;
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryPoolMXBean;
+import java.lang.management.MemoryType;
+import java.util.ArrayList;
+
+public class GeneratorBenchmark
+{
+	// the old way of growing the signal: every frame copies all samples before it
+	static class AppendingSink implements SignalSink
+	{
+		double[] signal=new double[0];
+
+		public void write(double[] s)
+		{
+			double[] d=new double[signal.length+s.length];
+			System.arraycopy(signal,0,d,0,signal.length);
+			System.arraycopy(s,0,d,signal.length,s.length);
+			signal=d;
+		}
+
+		public long getLength()
+		{
+			return signal.length;
+		}
+	}
+
+	static WavCodeGenerator makeGenerator(int sampleRate)
+	{
+		WavCodeGenerator wg=new WavCodeGenerator();
+		wg.setSampleRate(sampleRate);
+		wg.setBitRate(sampleRate/4.0);
+		return wg;
+	}
+
+	static void resetPeakHeap()
+	{
+		System.gc();
+		for(MemoryPoolMXBean pool : ManagementFactory.getMemoryPoolMXBeans())
+		{
+			if(pool.getType()==MemoryType.HEAP) pool.resetPeakUsage();
+		}
+	}
+
+	static long peakHeap()
+	{
+		long sum=0;
+		for(MemoryPoolMXBean pool : ManagementFactory.getMemoryPoolMXBeans())
+		{
+			if(pool.getType()==MemoryType.HEAP) sum+=pool.getPeakUsage().getUsed();
+		}
+		return sum;
+	}
+
+	// seconds of the best of three runs and the peak heap in bytes
+	static double[] measure(int[] data, int sampleRate, boolean streaming, File wavFile) throws Exception
+	{
+		double best=Double.MAX_VALUE;
+		long heap=0;
+
+		for(int run=0;run<3;run++)
+		{
+			WavCodeGenerator wg=makeGenerator(sampleRate);
+			resetPeakHeap();
+			long start=System.nanoTime();
+			if(streaming) wg.writeWav(data,null,wavFile);
+			else
+			{
+				AppendingSink sink=new AppendingSink();
+				wg.writeSignal(data,null,sink);
+				wg.saveWav(sink.signal,wavFile);
+			}
+			best=Math.min(best,(System.nanoTime()-start)*1e-9);
+			heap=Math.max(heap,peakHeap());
+		}
+		return new double[] {best,heap};
+	}
+
+	public static void main(String[] args) throws Exception
+	{
+		ArrayList<File> hexFiles=new ArrayList<File>();
+		String[] dirs=args.length>0 ? args : new String[] {"../build","../build/old"};
+		int[] rates={44100,192000};
+
+		for(String name : dirs)
+		{
+			File f=new File(name);
+			File[] list=f.isDirectory() ? f.listFiles() : new File[] {f};
+			if(list==null) continue;
+			for(File h : list)
+			{
+				if(h.getName().toLowerCase().endsWith(".hex")) hexFiles.add(h);
+			}
+		}
+
+		File wavFile=File.createTempFile("benchmark",".wav");
+		wavFile.deleteOnExit();
+
+		System.out.println(String.format("%-45s %7s %7s %9s %9s %9s %9s","hex file","bytes","rate","old s","stream s","old MB","stream MB"));
+		for(File h : hexFiles)
+		{
+			int[] data=IntelHexFormat.toUnsignedIntArray(IntelHexFormat.discardHeaderBytes(IntelHexFormat.IntelHexFormatToByteArray(h)));
+			for(int rate : rates)
+			{
+				double[] old=measure(data,rate,false,wavFile);
+				double[] stream=measure(data,rate,true,wavFile);
+				System.out.println(String.format("%-45s %7d %7d %9.3f %9.3f %9.1f %9.1f",h.getName(),data.length,rate,
+						old[0],stream[0],old[1]/1e6,stream[1]/1e6));
+			}
+		}
+	}
+}
@@ -1,4 +1,3 @@
-
 package wavCreator;
 
 public class HexToSignal 
@@ -14,69 +13,235 @@ public class HexToSignal
 	private int     lowNumberOfPulses   =  2; // not for manchester coding, only for flankensignal
 	private int     highNumberOfPulses  =  3; // not for manchester coding, only for flankensignal
 	
-	private int     manchesterNumberOfSamplesPerBit = 4; // this value must be even
+	private double  samplesPerBit = 4; // at least 2, need not be an integer
 	private boolean useDifferentialManchsterCode = true;
 	
+	private boolean invertSymbols = false; // for an inverting input circuit, see setInvertSymbols()
+	
+	/* band limited edges: each edge is a windowed sinc step, so an edge between two
+	 * samples keeps its exact time. Without band limiting the edge is moved to the
+	 * nearest sample. Used automatically if half a bit is not a whole number of samples.
+	 */
+	private boolean bandLimited = false;
+	private static final int    STEPWIDTH      = 8;    // samples on each side of an edge
+	private static final int    STEPRESOLUTION = 256;  // table entries per sample
+	private static final double CUTOFF         = 0.45; // low pass cutoff as fraction of the sample rate
+	private static double[]     stepTable;
+	
+	/* pre-emphasis for the high pass of the input network ( coupling capacitor into the bias divider )
+	 * the inverse filter x + integral(x)/tau boosts each transition and lets the level rise until
+	 * the next edge, so the droop of the receiver input is cancelled. The integral leaks within
+	 * 8 bits and the signal is scaled down by 1+samplesPerBit/tau to stay in the range of the wav file.
+	 */
+	private double preEmphasisTime  = 0; // time constant in samples, 0: off
+	private double preEmphasisState = 0; // integral of the signal
+	
+	// the signal built by the coding functions: level changes at fractional sample positions
+	private double   bitPosition;      // start of the next bit in samples
+	private double   timeOffset  = 0;  // start of the next signal, the fraction of the last sample is carried over
+	private double   signalLevel = 0;  // level after the last edge
+	private double   startLevel;
+	private double[] edgeTime;
+	private double[] edgeStep;
+	private int      numEdges;
+	
 	public void setSignalSpeed(boolean fullSpeedFlag)
 	{
-		if( fullSpeedFlag ) manchesterNumberOfSamplesPerBit = 4; // full speed
-		else                manchesterNumberOfSamplesPerBit = 8; // half speed
+		if( fullSpeedFlag ) setSamplesPerBit(4); // full speed
+		else                setSamplesPerBit(8); // half speed
 	}
 	
 	public HexToSignal(boolean fullSpeedFlag)
 	{
 		setSignalSpeed(fullSpeedFlag);
 	}
+	
+	// any bit rate: samples per bit = sample rate / bit rate
+	public void setSamplesPerBit(double samplesPerBit)
+	{
+		if(samplesPerBit<2) throw new IllegalArgumentException("at least 2 samples per bit are needed");
+		this.samplesPerBit = samplesPerBit;
+		bandLimited = samplesPerBit/2 != Math.floor(samplesPerBit/2);
+	}
+	
+	// time constant of the input high pass in samples, 0 switches the pre-emphasis off
+	public void setPreEmphasis(double timeConstant)
+	{
+		preEmphasisTime = timeConstant;
+	}
+	
+	/* the receiver needs the first half of a symbol above the bias level, an inverting
+	 * input circuit ( e.g. a transistor stage ) is compensated by inverted symbols
+	 */
+	public void setInvertSymbols(boolean invertSymbols)
+	{
+		this.invertSymbols = invertSymbols;
+	}
+	
+	public void setBandLimited(boolean bandLimited)
+	{
+		this.bandLimited = bandLimited;
+	}
+	
+	public void setStartSequencePulses(int startSequencePulses)
+	{
+		this.startSequencePulses = startSequencePulses;
+	}
+	
+	public int getStartSequencePulses()
+	{
+		return startSequencePulses;
+	}
+	
+	public double getSamplesPerBit()
+	{
+		return samplesPerBit;
+	}
+	
+	/* lengthen the synchronisation sequence by the given time
+	 * the receiver ignores the additional pulses, so the time can be used
+	 * by the bootloader to program the previous frame
+	 */
+	public void addPreambleTime(double seconds, int sampleRate)
+	{
+		startSequencePulses += (int)Math.ceil(seconds * sampleRate / samplesPerBit);
+	}
+	
+	private void beginSignal(int bits)
+	{
+		edgeTime=new double[2*bits+1];
+		edgeStep=new double[2*bits+1];
+		numEdges=0;
+		startLevel=signalLevel;
+		bitPosition=timeOffset;
+	}
+	
+	// the signal changes to the value at the time given in samples
+	private void setLevel(double time, double value)
+	{
+		if(value==signalLevel) return;
+		edgeTime[numEdges]=time;
+		edgeStep[numEdges]=value-signalLevel;
+		numEdges++;
+		signalLevel=value;
+	}
+	
+	// integral of a Blackman windowed sinc low pass, from -STEPWIDTH to STEPWIDTH samples
+	private static double[] createStepTable()
+	{
+		int length=2*STEPWIDTH*STEPRESOLUTION;
+		double[] table=new double[length+1];
+		double sum=0;
+		
+		for(int k=0;k<=length;k++)
+		{
+			double x=(double)k/STEPRESOLUTION-STEPWIDTH;
+			double sinc=1;
+			if(x!=0) sinc=Math.sin(2*Math.PI*CUTOFF*x)/(2*Math.PI*CUTOFF*x);
+			double window=0.42+0.5*Math.cos(Math.PI*x/STEPWIDTH)+0.08*Math.cos(2*Math.PI*x/STEPWIDTH);
+			sum+=sinc*window;
+			table[k]=sum;
+		}
+		for(int k=0;k<=length;k++) table[k]/=sum;
+		return table;
+	}
+	
+	/* samples of the signal from bitPosition=timeOffset to the end of the last bit
+	 * an edge at the time t is centered between the samples t-1 and t
+	 */
+	private double[] endSignal()
+	{
+		int length=(int)Math.ceil(bitPosition);
+		double[] signal=new double[length];
+		double value=startLevel;
+		int k=0;
+		
+		timeOffset=bitPosition-length;
+		for(int n=0;n<length;n++)
+		{
+			while(k<numEdges && edgeTime[k]<n+0.5) value+=edgeStep[k++];
+			signal[n]=value;
+		}
+		
+		if(bandLimited)
+		{
+			if(stepTable==null) stepTable=createStepTable();
+			for(k=0;k<numEdges;k++)
+			{
+				double center=edgeTime[k]-0.5;
+				for(int n=Math.max(0,(int)Math.ceil(center-STEPWIDTH));n<length && n<center+STEPWIDTH;n++)
+				{
+					double x=n-center;
+					double ideal=0;
+					if(x>0) ideal=1;
+					signal[n]+=edgeStep[k]*(stepTable[(int)Math.round((x+STEPWIDTH)*STEPRESOLUTION)]-ideal);
+				}
+			}
+			// the overshoot of the steps must not exceed the range of the wav file
+			for(int n=0;n<length;n++) signal[n]=Math.max(-1,Math.min(1,signal[n]));
+		}
+		return signal;
+	}
+	
+	private void preEmphasis(double[] signal)
+	{
+		double leak=1-1/(8*samplesPerBit);
+		double scale=1/(1+samplesPerBit/preEmphasisTime);
+		
+		for(int n=0;n<signal.length;n++)
+		{
+			preEmphasisState=preEmphasisState*leak+signal[n]/preEmphasisTime;
+			signal[n]=Math.max(-1,Math.min(1,scale*(signal[n]+preEmphasisState)));
+		}
+	}
+	
 	/* flag=true: rising edge
 	 * flag=false: falling edge
 	 */
-	private double[] manchesterEdge(boolean flag, int pointerIntoSignal, double signal[] )
+	private void manchesterEdge(boolean flag)
 	{
-		double sigpart[]=new double[manchesterNumberOfSamplesPerBit];
-		int n;
 		double value;
+		double middle=bitPosition+samplesPerBit/2;
 
 		if( !useDifferentialManchsterCode ) // non differential manchester code
 		{
 			if(flag) value=1;
 			else value=-1;
 			if(invertSignal)value=value*-1;  // correction of an inverted audio signal line
-			for(n=0;n<manchesterNumberOfSamplesPerBit;n++)
-			{
-				if(n<manchesterNumberOfSamplesPerBit/2)signal[pointerIntoSignal]=-value;
-				else signal[pointerIntoSignal]=value;
-				pointerIntoSignal++;
-			}
+			setLevel(bitPosition,-value);
+			setLevel(middle,value);
 		}
 		else // differential manchester code ( inverted )
 		{
 			if(flag) manchesterPhase=-manchesterPhase; // toggle phase
-			for(n=0;n<manchesterNumberOfSamplesPerBit;n++)
-			{
-				if(n==(manchesterNumberOfSamplesPerBit/2))manchesterPhase=-manchesterPhase; // toggle phase
-				signal[pointerIntoSignal]=manchesterPhase;
-				pointerIntoSignal++;
-			}		
+			setLevel(bitPosition,manchesterPhase);
+			manchesterPhase=-manchesterPhase; // toggle phase
+			setLevel(middle,manchesterPhase);
 		}
-		return sigpart;
+		bitPosition+=samplesPerBit;
 	}
 
 	public double[] manchesterCoding(int hexdata[])
 	{
-		int laenge=hexdata.length;
-		double[] signal=new double[(1+startSequencePulses+laenge*8)*manchesterNumberOfSamplesPerBit];
+		return manchesterCoding(hexdata,startSequencePulses);
+	}
+	
+	/* 0 bits, start bit and data
+	 * the phase continues from the last call, so blocks of a multi page frame
+	 * can be appended without an additional edge
+	 */
+	public double[] manchesterCoding(int hexdata[], int zeroBits)
+	{
+		beginSignal(1+zeroBits+hexdata.length*8);
 		
-		int counter=0;
 		/** generate synchronisation start sequence **/
-		for (int n=0; n<startSequencePulses; n++)
+		for (int n=0; n<zeroBits; n++)
 		{
-			manchesterEdge(false,counter,signal); // 0 bits: generate falling edges 
-			counter+=manchesterNumberOfSamplesPerBit;
+			manchesterEdge(false); // 0 bits: generate falling edges 
 		}
 		
 		/** start bit **/
-		manchesterEdge(true,counter,signal); //  1 bit:  rising edge 
-		counter+=manchesterNumberOfSamplesPerBit;
+		manchesterEdge(true); //  1 bit:  rising edge 
 		
 		/** create data signal **/
 		int count=0;
@@ -87,14 +252,46 @@ public class HexToSignal
 			/** create one byte **/			
 			for( int n=0;n<8;n++) // first bit to send: MSB
 			{
-				if((dat&0x80)==0) 	manchesterEdge(false,counter,signal); // generate falling edges ( 0 bits )
-				else 				manchesterEdge(true,counter,signal); // rising edge ( 1 bit )
-				counter+=manchesterNumberOfSamplesPerBit;	
+				if((dat&0x80)==0) 	manchesterEdge(false); // generate falling edges ( 0 bits )
+				else 				manchesterEdge(true); // rising edge ( 1 bit )
 				dat=dat<<1; // shift to next bit
 			}
 		}
+		double[] signal=endSignal();
+		if(preEmphasisTime>0) preEmphasis(signal);
 		return signal;	
 	}
+	
+	/* one symbol of the 4 level code: first half positive, second half negative
+	 * so the symbol has no DC part and the input pin toggles in the middle of each symbol
+	 */
+	private void symbol(int level)
+	{
+		double amplitude=(double)BootFrame.symbolLevel(level)/BootFrame.symbolLevel(3);
+		if(invertSymbols) amplitude=-amplitude;
+		setLevel(bitPosition,amplitude);
+		setLevel(bitPosition+samplesPerBit/2,-amplitude);
+		bitPosition+=samplesPerBit;
+	}
+	
+	/* 4 level amplitude code, 2 bits per symbol, see receiveSymbolFrame() in TinyAudioBoot.c
+	 * the symbol time is the manchester bit time
+	 * full amplitude symbols for synchronisation, lowest level start symbol, data MSB first
+	 */
+	public double[] symbolCoding(int hexdata[])
+	{
+		beginSignal(1+startSequencePulses+hexdata.length*4);
+		
+		for (int n=0; n<startSequencePulses; n++) symbol(3);
+		symbol(0); // start symbol
+		
+		for(int count=0;count<hexdata.length;count++)
+		{
+			for(int n=6;n>=0;n-=2) symbol((hexdata[count]>>n)&3);
+		}
+		return endSignal();
+	}
+	
 	public double[] flankensignal(int hexdata[])
 	{
 		int intro=startSequencePulses*lowNumberOfPulses+numStartBits*highNumberOfPulses+numStopBits*lowNumberOfPulses;
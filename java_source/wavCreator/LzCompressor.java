@@ -0,0 +1,113 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	LZ compression of the flash image for compressed frames
+
+	token format ( see decompressPages() in TinyAudioBoot.c ):
+	  0x00..0x7F  literal run: the next c+1 bytes are copied
+	  0x80..0xFF  match: (c&0x7F)+MINMATCH bytes are copied from "distance" bytes
+	              before, followed by distance low byte and distance high byte
+
+	The bootloader holds only the current page in SRAM and programs it as soon
+	as it is complete, so a match may refer to every byte of the image before.
+	The reset vector at address 0 and 1 is patched by the bootloader and never
+	used as source. Tokens do not cross page boundaries, so every page is
+	compressed on its own and the pages can be combined into frames freely.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+public class LzCompressor
+{
+	public static final int MINMATCH    = 3;
+	public static final int MAXMATCH    = 0x7F + MINMATCH;
+	public static final int MAXLITERALS = 0x80;
+	public static final int FIRSTSOURCE = 2;	// the reset vector is patched by the bootloader
+
+	private int[] data;
+	private int pageSize;
+
+	// the data is padded with 0xFF to whole pages
+	public LzCompressor(int data[], int pageSize)
+	{
+		this.pageSize=pageSize;
+		int pages=(data.length+pageSize-1)/pageSize;
+		this.data=new int[pages*pageSize];
+		for(int n=0;n<this.data.length;n++)
+		{
+			if(n<data.length) this.data[n]=data[n];
+			else this.data[n]=0xFF;
+		}
+	}
+
+	private int addLiterals(int out[], int outLength, int from, int to)
+	{
+		while(from<to)
+		{
+			int n=Math.min(MAXLITERALS,to-from);
+			out[outLength++]=n-1;
+			for(int k=0;k<n;k++) out[outLength++]=data[from++];
+		}
+		return outLength;
+	}
+
+	public int[] compressPage(int page)
+	{
+		return compressPage(page,0);
+	}
+
+	/* compressed data of one page, greedy search for the longest match
+	 * the matches refer only to the pages from firstPage on: a resumed playback ( USE_RESUME )
+	 * starts at a chapter and the pages of the chapters before it may not be programmed yet
+	 */
+	public int[] compressPage(int page, int firstPage)
+	{
+		int firstSource=Math.max(FIRSTSOURCE,firstPage*pageSize);
+		int start=page*pageSize;
+		int end=start+pageSize;
+		int[] out=new int[pageSize*2];
+		int outLength=0;
+		int literals=start;
+		int pos=start;
+
+		while(pos<end)
+		{
+			int maxLength=Math.min(MAXMATCH,end-pos);
+			int bestLength=0;
+			int bestDistance=0;
+
+			for(int src=pos-1;src>=firstSource && bestLength<maxLength;src--)
+			{
+				int l=0;
+				while(l<maxLength && data[src+l]==data[pos+l]) l++;
+				if(l>bestLength)
+				{
+					bestLength=l;
+					bestDistance=pos-src;
+				}
+			}
+
+			// a match of MINMATCH bytes is as long as the literals
+			if(bestLength>MINMATCH)
+			{
+				outLength=addLiterals(out,outLength,literals,pos);
+				out[outLength++]=0x80|(bestLength-MINMATCH);
+				out[outLength++]=bestDistance&0xFF;
+				out[outLength++]=(bestDistance>>8)&0xFF;
+				pos+=bestLength;
+				literals=pos;
+			}
+			else pos++;
+		}
+		outLength=addLiterals(out,outLength,literals,end);
+
+		int[] result=new int[outLength];
+		for(int n=0;n<outLength;n++) result[n]=out[n];
+		return result;
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	signal written as 16 bit stereo PCM to an output stream: stdout, a named pipe
+	or the sound line ( SoundLineStream )
+
+	The length of a stream is not known in advance, the optional wav header uses the
+	size 0xFFFFFFFF like other streaming tools ( aplay, sox ), a wav file gets its sizes
+	when it is closed ( WavCodeGenerator.writeWav() ). The frames are written as soon as
+	they are encoded, the delay until the first sound does not depend on the image size.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import java.io.IOException;
+import java.io.OutputStream;
+
+public class PcmStreamSink implements SignalSink
+{
+	public static final long UNKNOWNSIZE=0xFFFFFFFFL;
+	private static final double SCALE=32767;	// same quantisation as WavFile with 16 bits
+	private OutputStream out;
+	private byte[] buffer=new byte[4096*4];
+	private long length=0;
+
+	public PcmStreamSink(OutputStream out)
+	{
+		this.out=out;
+	}
+
+	// RIFF header of a 16 bit stereo wav with unknown length, has to be written before the first frame
+	public void writeWavHeader(int sampleRate) throws IOException
+	{
+		byte[] header=new byte[44];
+		putString(header,0,"RIFF");
+		putLE(header,4,UNKNOWNSIZE,4);
+		putString(header,8,"WAVE");
+		putString(header,12,"fmt ");
+		putLE(header,16,16,4);
+		putLE(header,20,1,2);				// PCM
+		putLE(header,22,2,2);				// channels
+		putLE(header,24,sampleRate,4);
+		putLE(header,28,sampleRate*4,4);	// bytes per second
+		putLE(header,32,4,2);				// block align
+		putLE(header,34,16,2);				// bits per sample
+		putString(header,36,"data");
+		putLE(header,40,UNKNOWNSIZE,4);
+		out.write(header);
+	}
+
+	public void write(double[] signal) throws IOException
+	{
+		int k=0;
+		for(int n=0;n<signal.length;n++)
+		{
+			long value=(long)(SCALE*signal[n]);
+			for(int c=0;c<2;c++)
+			{
+				buffer[k++]=(byte)value;
+				buffer[k++]=(byte)(value>>8);
+			}
+			if(k==buffer.length)
+			{
+				out.write(buffer,0,k);
+				k=0;
+			}
+		}
+		out.write(buffer,0,k);
+		out.flush(); // each frame reaches the pipe as soon as it is encoded
+		length+=signal.length;
+	}
+
+	public long getLength()
+	{
+		return length;
+	}
+
+	private static void putString(byte[] b, int offset, String s)
+	{
+		for(int n=0;n<s.length();n++) b[offset+n]=(byte)s.charAt(n);
+	}
+
+	private static void putLE(byte[] b, int offset, long value, int bytes)
+	{
+		for(int n=0;n<bytes;n++) b[offset+n]=(byte)(value>>(8*n));
+	}
+}
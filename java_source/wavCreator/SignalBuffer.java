@@ -0,0 +1,41 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	signal in memory: the buffer grows by doubling, so appending a frame
+	costs the frame length and not the length of the whole signal
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import java.util.Arrays;
+
+public class SignalBuffer implements SignalSink
+{
+	private double[] samples=new double[4096];
+	private long length=0;
+
+	public void write(double[] signal)
+	{
+		if(length+signal.length>samples.length)
+		{
+			samples=Arrays.copyOf(samples,(int)Math.max(2L*samples.length,length+signal.length));
+		}
+		System.arraycopy(signal,0,samples,(int)length,signal.length);
+		length+=signal.length;
+	}
+
+	public long getLength()
+	{
+		return length;
+	}
+
+	public double[] toArray()
+	{
+		return Arrays.copyOf(samples,(int)length);
+	}
+}
@@ -0,0 +1,26 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	destination of the generated signal
+
+	The generator writes the signal frame by frame, see WavCodeGenerator.writeSignal().
+	A sink keeps the samples in memory ( SignalBuffer ) or writes them straight
+	into a wav file ( WavFileSink ), then the memory does not depend on the image size.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import java.io.IOException;
+
+public interface SignalSink
+{
+	public void write(double[] signal) throws IOException;
+
+	// number of samples written so far
+	public long getLength();
+}
@@ -0,0 +1,68 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	the sound card as output stream for the PcmStreamSink, 16 bit stereo PCM
+	The line buffer holds 0.25 seconds, the playback starts with the first frame.
+	The line only accepts whole sample frames ( 4 bytes ), the bytes of an
+	incomplete one are kept until the next write.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import java.io.OutputStream;
+
+import javax.sound.sampled.AudioFormat;
+import javax.sound.sampled.AudioSystem;
+import javax.sound.sampled.LineUnavailableException;
+import javax.sound.sampled.SourceDataLine;
+
+public class SoundLineStream extends OutputStream
+{
+	private static final int FRAMESIZE=4;	// bytes of a sample frame: 2 channels with 16 bits
+	private SourceDataLine line;
+	private byte[] frame=new byte[FRAMESIZE];
+	private int frameBytes=0;				// bytes of the incomplete sample frame
+
+	public SoundLineStream(int sampleRate) throws LineUnavailableException
+	{
+		AudioFormat format=new AudioFormat(sampleRate,16,2,true,false);
+		line=AudioSystem.getSourceDataLine(format);
+		line.open(format,sampleRate);	// bytes: 0.25 seconds
+		line.start();
+	}
+
+	public void write(int b)
+	{
+		frame[frameBytes++]=(byte)b;
+		if(frameBytes==FRAMESIZE)
+		{
+			line.write(frame,0,FRAMESIZE);
+			frameBytes=0;
+		}
+	}
+
+	public void write(byte[] b, int offset, int length)
+	{
+		// complete the sample frame of the last write first
+		while(frameBytes>0 && length>0)
+		{
+			write(b[offset++]);
+			length--;
+		}
+		int whole=length-length%FRAMESIZE;
+		if(whole>0) line.write(b,offset,whole);
+		for(int n=whole;n<length;n++) write(b[offset+n]);
+	}
+
+	// the remaining samples are played before the line is closed, an incomplete sample frame is dropped
+	public void close()
+	{
+		line.drain();
+		line.close();
+	}
+}
@@ -16,6 +16,8 @@ package wavCreator;
 import hexTools.IntelHexFormat;
 
 import java.io.*;
+import java.util.ArrayList;
+import java.util.Arrays;
 
 import waveFile.WavFile;
 
@@ -24,6 +26,28 @@ public class WavCodeGenerator
 	private int sampleRate = 44100;		// Samples per second
 	private BootFrame frameSetup;
 	boolean fullSpeedFlag=true;
+	double bitRate=0;					// bits per second, 0: full or half speed
+	boolean gaplessFrames=true;			// no silence between the frames, the preamble covers the programming time
+	boolean compression=false;			// compressed frames, only for bootloaders compiled with USE_COMPRESSION
+	int pagesPerFrame=1;				// more than 1: multi page frames, only for bootloaders compiled with USE_MULTIPAGE
+	int blockGapBits=4;					// 0 bits before each page block of a multi page frame
+	boolean symbolMode=false;			// 4 level symbols, only for bootloaders compiled with USE_ADC_SYMBOLS
+	boolean invertSymbols=false;		// inverted symbols for an inverting input circuit
+	boolean eepromQueue=false;			// EEPROM bytes are written during the next frame, only for bootloaders compiled with USE_EEPROMQUEUE
+	double preEmphasisTime=0;			// time constant of the input network in seconds, 0: no pre-emphasis
+	double leadInTime=0;				// additional preamble of the first frame in seconds
+	int chapterPages=0;					// pages per chapter of a resumable wav, 0: no chapters
+	boolean shortSync=false;			// full preamble only on the first frame, only for bootloaders compiled with USE_SHORTSYNC
+	private boolean synchronised=false;	// the bootloader has measured the bit time on a frame of this signal
+	private ArrayList<Long> cuePoints=new ArrayList<Long>();		// sample positions of the chapters
+	private ArrayList<String> cueLabels=new ArrayList<String>();
+	private double nextPreambleTime=0;	// additional preamble in seconds for the next frame
+	private long endFramePosition=0;	// sample position of the RUN or EXIT frame, see writeStereoWav()
+	
+	public static final int EEPROMSIZE = 512;	// Attiny85
+	public static final int RESUMESIZE = 16;	// EEPROM bytes of the resume state, RESUMESIZE in TinyAudioBoot.c
+	public static final int RESUMESTATE = EEPROMSIZE-32;	// the bytes from here on belong to USE_RESUME
+	public static final int FASTSTARTCONFIG = EEPROMSIZE-1;	// start window of USE_FASTSTART in ms
 	
 	public WavCodeGenerator()
 	{
@@ -45,23 +69,220 @@ public class WavCodeGenerator
 		this.fullSpeedFlag = fullSpeedFlag;
 	}
 	
-	public double[] generatePageSignal(int data[])
+	// 44100, 48000, 96000, 192000 or any other sample rate of the wav file
+	public void setSampleRate(int sampleRate)
+	{
+		this.sampleRate = sampleRate;
+	}
+	
+	// any bit rate with at least 2 samples per bit, replaces the full or half speed
+	public void setBitRate(double bitRate)
+	{
+		this.bitRate = bitRate;
+	}
+	
+	// full speed is 11025 bit/s ( 4 samples per bit at 44.1kHz ), half speed 5512.5 bit/s
+	public double getSamplesPerBit()
+	{
+		double rate=bitRate;
+		if(rate==0)
+		{
+			if(fullSpeedFlag) rate=44100/4.0;
+			else rate=44100/8.0;
+		}
+		return sampleRate/rate;
+	}
+	
+	/* pre-emphasis for the coupling capacitor and the bias resistors of the input circuit
+	 * the time constant is C*(R1||R2), 100nF and 10k/10k: setPreEmphasis(5e3,100e-9)
+	 * resistance 0 switches the pre-emphasis off
+	 */
+	public void setPreEmphasis(double resistance, double capacitance)
+	{
+		this.preEmphasisTime = resistance*capacitance;
+	}
+	
+	public void setGaplessFrames(boolean gaplessFrames)
+	{
+		this.gaplessFrames = gaplessFrames;
+	}
+	
+	// forward error correction, only for bootloaders compiled with USE_FEC
+	public void setFec(boolean fec)
+	{
+		frameSetup.setFec(fec);
+	}
+	
+	public void setCompression(boolean compression)
+	{
+		this.compression = compression;
+	}
+	
+	public void setPagesPerFrame(int pagesPerFrame)
+	{
+		this.pagesPerFrame = pagesPerFrame;
+	}
+	
+	// the wav starts with a manchester coded symbol mode frame, all other frames are sent as
+	// symbols without FEC data, compression and multi page frames are not used
+	public void setSymbolMode(boolean symbolMode)
+	{
+		this.symbolMode = symbolMode;
+	}
+	
+	// the symbols are received only if the input circuit does not invert the signal, otherwise invert them here
+	public void setInvertSymbols(boolean invertSymbols)
+	{
+		this.invertSymbols = invertSymbols;
+	}
+	
+	/* a bootloader compiled with USE_FASTSTART only starts if the signal is present at reset:
+	 * with a lead in the playback can be started first and the device reset within this time
+	 */
+	public void setLeadInTime(double leadInTime)
+	{
+		this.leadInTime = leadInTime;
+	}
+	
+	// the bootloader writes the bytes of an EEPROM frame while it receives the next frame
+	public void setEepromQueue(boolean eepromQueue)
+	{
+		this.eepromQueue = eepromQueue;
+	}
+	
+	/* the bootloader keeps the bit time of the first frame, the following frames
+	 * start with BootFrame.SHORTSYNCBITS 0 bits instead of the full preamble
+	 */
+	public void setShortSync(boolean shortSync)
+	{
+		this.shortSync = shortSync;
+	}
+	
+	/* resumable programming, only for bootloaders compiled with USE_RESUME: every chapterPages
+	 * pages an image frame starts a chapter, a cue point in the wav file marks its position.
+	 * After an interruption the playback can be started again at any chapter.
+	 */
+	public void setChapterPages(int chapterPages)
+	{
+		this.chapterPages = chapterPages;
+	}
+	
+	/* the image id is the crc16 of the pages, 0xFFFF means no image in the bootloader
+	 */
+	public int getImageId(int data[])
+	{
+		int pl=frameSetup.getPageSize();
+		int pages=(data.length+pl-1)/pl;
+		int c=0xFFFF;
+		for(int n=0;n<pages*pl;n++) c=BootFrame.crcCcittUpdate(c,n<data.length ? data[n] : 0xFF);
+		if(c==0xFFFF) c=0xFFFE;
+		return c;
+	}
+	
+	/* programming time of a page of a compressed or multi page frame: with chapters the bootloader
+	 * marks each page in the EEPROM, the next page waits for this write ( USE_RESUME )
+	 */
+	private double getPageProgrammingTime()
+	{
+		double time=frameSetup.getProgrammingTime();
+		if(chapterPages>0) time+=frameSetup.getEepromWriteTime();
+		return time;
+	}
+	
+	// duration of the current frame without the additional preamble in seconds
+	public double getFrameDuration()
 	{
 		HexToSignal h2s=new HexToSignal(fullSpeedFlag);
+		h2s.setSamplesPerBit(getSamplesPerBit());
+		if(isShortPreamble()) h2s.setStartSequencePulses(BootFrame.SHORTSYNCBITS);
+		int bits=1+h2s.getStartSequencePulses()+frameSetup.getFrameSize()*(symbolMode ? 4 : 8);
+		return (double)bits*h2s.getSamplesPerBit()/sampleRate;
+	}
+	
+	// symbol frames are synchronised by their own preamble
+	private boolean isShortPreamble()
+	{
+		return shortSync && synchronised && !symbolMode;
+	}
+	
+	// the encoder for the next frame, the preamble is lengthened while the bootloader is still programming
+	private HexToSignal createEncoder()
+	{
+		HexToSignal h2s=new HexToSignal(fullSpeedFlag);
+		h2s.setSamplesPerBit(getSamplesPerBit());
+		h2s.setPreEmphasis(preEmphasisTime*sampleRate);
+		h2s.setInvertSymbols(invertSymbols);
+		if(isShortPreamble()) h2s.setStartSequencePulses(BootFrame.SHORTSYNCBITS);
+		h2s.addPreambleTime(nextPreambleTime, sampleRate);
+		nextPreambleTime=0;
+		synchronised=true;
+		return h2s;
+	}
+	
+	private double[] coding(HexToSignal h2s, int frameData[])
+	{
+		if(symbolMode) return h2s.symbolCoding(frameData);
+		return h2s.manchesterCoding(frameData);
+	}
+	
+	public double[] generatePageSignal(int data[])
+	{
+		HexToSignal h2s=createEncoder();
 
 		int[] frameData=new int[frameSetup.getFrameSize()];
 
 		// copy data into frame data
-		for(int n=0;n<frameSetup.getPageSize();n++)
+		for(int n=0;n<frameSetup.getDataSize();n++)
 		{
 			if ( n < data.length ) frameData[n+frameSetup.getPageStart()]=data[n];
 			else frameData[n+frameSetup.getPageStart()]=0xFF;
 		}
 		frameSetup.addFrameParameters(frameData);
-		double[] signal=h2s.manchesterCoding(frameData);
+		double[] signal=coding(h2s,frameData);
 		return signal;
 	}
 	
+	// header and numPages page blocks, the data starts at the page index of the frame
+	public double[] generateMultiPageSignal(int data[], int numPages)
+	{
+		SignalBuffer signal=new SignalBuffer();
+		try
+		{
+			writeMultiPageSignal(data,numPages,signal);
+		}
+		catch(IOException e) {} // not thrown by a SignalBuffer
+		return signal.toArray();
+	}
+	
+	// as generateMultiPageSignal(), the header and each page block are written into the sink when encoded
+	public void writeMultiPageSignal(int data[], int numPages, SignalSink signal) throws IOException
+	{
+		HexToSignal h2s=createEncoder();
+		int pl=frameSetup.getPageSize();
+		int firstByte=frameSetup.getPageIndex()*pl;
+		
+		frameSetup.setMultiPageCommand();
+		frameSetup.setTotalLength(numPages*pl);
+		int[] frameData=new int[frameSetup.getFrameSize()];
+		frameSetup.addFrameParameters(frameData);
+		signal.write(h2s.manchesterCoding(frameData));
+		
+		for(int k=0;k<numPages;k++)
+		{
+			int[] page=new int[pl];
+			for(int n=0;n<pl;n++)
+			{
+				int i=firstByte+k*pl+n;
+				if(i<data.length) page[n]=data[i];
+				else page[n]=0xFF;
+			}
+			// the 0 bits before the block cover the programming time of the previous page
+			int zeroBits=blockGapBits;
+			if(k>0) zeroBits+=(int)Math.ceil(getPageProgrammingTime()*sampleRate/h2s.getSamplesPerBit());
+			signal.write(h2s.manchesterCoding(frameSetup.makePageBlock(page),zeroBits));
+		}
+	}
+	
 	// duration in seconds
 	public double[] silence(double duration)
 	{
@@ -71,64 +292,269 @@ public class WavCodeGenerator
 	
 	public double[] makeRunCommand()
 	{
-		HexToSignal h2s=new HexToSignal(fullSpeedFlag);
+		HexToSignal h2s=createEncoder();
+		frameSetup.setRunCommand(); // before the size: compressed and multi page frames are shorter
 		int[] frameData=new int[frameSetup.getFrameSize()];
-		frameSetup.setRunCommand();
 		frameSetup.addFrameParameters(frameData);
-		double[] signal=h2s.manchesterCoding(frameData);
+		double[] signal=coding(h2s,frameData);
 		return signal;
 	}
 	
 	public double[] makeTestCommand()
 	{
-		HexToSignal h2s=new HexToSignal(fullSpeedFlag);
-		int[] frameData=new int[frameSetup.getFrameSize()];
+		HexToSignal h2s=createEncoder();
 		frameSetup.setTestCommand();
+		int[] frameData=new int[frameSetup.getFrameSize()];
 		frameSetup.addFrameParameters(frameData);
-		double[] signal=h2s.manchesterCoding(frameData);
+		double[] signal=coding(h2s,frameData);
 		return signal;
 	}	
 	
+	// switches the bootloader to symbol reception, always manchester coded
+	public double[] makeSymbolModeCommand()
+	{
+		HexToSignal h2s=createEncoder();
+		frameSetup.setSymbolModeCommand();
+		int[] frameData=new int[frameSetup.getFrameSize()];
+		frameSetup.addFrameParameters(frameData);
+		double[] signal=h2s.manchesterCoding(frameData);
+		return signal;
+	}
+	
+	/* the bootloader starts a new session if the image id differs from the last one and
+	 * clears its page bitmap, the signal waits for RESUMESIZE EEPROM writes
+	 */
+	public double[] makeImageCommand(int data[])
+	{
+		synchronised=false; // the playback may start again at this chapter after a reset
+		HexToSignal h2s=createEncoder();
+		frameSetup.setImageCommand();
+		int[] frameData=new int[frameSetup.getFrameSize()];
+		for(int n=0;n<frameSetup.getDataSize();n++)
+		{
+			if(n<2 && n<data.length) frameData[n+frameSetup.getPageStart()]=data[n];
+			else frameData[n+frameSetup.getPageStart()]=0xFF;
+		}
+		frameSetup.setPageIndex(getImageId(data));
+		frameSetup.setTotalLength(data.length);
+		frameSetup.addFrameParameters(frameData);
+		double[] signal=coding(h2s,frameData);
+		
+		double clearTime=RESUMESIZE*frameSetup.getEepromWriteTime();
+		if(gaplessFrames) nextPreambleTime=clearTime;
+		else signal=appendSignal(signal,silence(frameSetup.getSilenceBetweenPages()+clearTime));
+		return signal;
+	}
+	
+	public double[] makeExitCommand()
+	{
+		HexToSignal h2s=createEncoder();
+		frameSetup.setExitCommand();
+		int[] frameData=new int[frameSetup.getFrameSize()];
+		frameSetup.addFrameParameters(frameData);
+		double[] signal=coding(h2s,frameData);
+		return signal;
+	}
+	
+	public double[] generateEepromSignal(int eeprom[])
+	{
+		SignalBuffer signal=new SignalBuffer();
+		synchronised=false;
+		try
+		{
+			writeEepromSignal(eeprom,signal);
+		}
+		catch(IOException e) {} // not thrown by a SignalBuffer
+		return signal.toArray();
+	}
+	
+	/* one frame for each page of the EEPROM with data in the eep file, from the start of the page
+	 * to the last byte of the file in this page. Bytes not in the file within this range are sent as 0xFF.
+	 * The bootloader writes only the bytes which differ, but the signal waits for all bytes.
+	 * With the EEPROM queue the writing overlaps the next frame, only the rest has to be waited for.
+	 */
+	public void writeEepromSignal(int eeprom[], SignalSink signal) throws IOException
+	{
+		int pl=frameSetup.getPageSize();
+		
+		for(int page=0;page*pl<eeprom.length;page++)
+		{
+			int length=0;
+			for(int n=0;n<pl && page*pl+n<eeprom.length;n++)
+			{
+				if(eeprom[page*pl+n]>=0) length=n+1;
+			}
+			if(length==0) continue;
+			
+			int[] data=new int[length];
+			for(int n=0;n<length;n++)
+			{
+				if(eeprom[page*pl+n]<0) data[n]=0xFF;
+				else data[n]=eeprom[page*pl+n];
+			}
+			frameSetup.setPageIndex(page);
+			frameSetup.setEepromCommand();
+			frameSetup.setTotalLength(length);
+			signal.write(generatePageSignal(data));
+			
+			double writeTime=length*frameSetup.getEepromWriteTime();
+			if(eepromQueue) writeTime=Math.max(0,writeTime-getFrameDuration());
+			if(gaplessFrames) nextPreambleTime=writeTime;
+			else signal.write(silence(frameSetup.getSilenceBetweenPages()+writeTime));
+		}
+	}
+	
 	public double[] generateSignal(int data[])
 	{
-		double[] signal=new double[1];
-		frameSetup.setProgCommand(); // we want to programm the mc
+		return generateSignal(data,null);
+	}
+	
+	public double[] generateSignal(int data[], int eeprom[])
+	{
+		SignalBuffer signal=new SignalBuffer();
+		try
+		{
+			writeSignal(data,eeprom,signal);
+		}
+		catch(IOException e) {} // not thrown by a SignalBuffer
+		return signal.toArray();
+	}
+	
+	/* flash data and EEPROM data ( null: no EEPROM frames ) in one wav file
+	 * without flash data the bootloader is left by EXITCOMMAND instead of RUNCOMMAND
+	 * the frames are written into the sink one after the other
+	 */
+	public void writeSignal(int data[], int eeprom[], SignalSink signal) throws IOException
+	{
 		int pl=frameSetup.getPageSize();
-		int total=data.length;
-		int sigPointer=0;
+		int pages=(data.length+pl-1)/pl;
 		int pagePointer=0;
-
-
-		while(total>0)
+		int frames=0;
+		int compressedSize=0;
+		double airtimeSaved=0;
+		int[][] compressedPages=new int[pages][];
+		boolean compression=this.compression && !symbolMode;
+		int pagesPerFrame=symbolMode ? 1 : this.pagesPerFrame;
+		boolean fec=frameSetup.getFec();
+		
+		int nextChapter=0;
+		
+		nextPreambleTime=leadInTime;
+		synchronised=false;
+		cuePoints.clear();
+		cueLabels.clear();
+		signal.write(new double[1]);
+		if(symbolMode)
+		{
+			signal.write(makeSymbolModeCommand());
+			frameSetup.setFec(false);
+		}
+		
+		if(compression)
 		{
-			frameSetup.setPageIndex(pagePointer++);
-			frameSetup.setTotalLength(data.length);
+			LzCompressor lz=new LzCompressor(data,pl);
+			for(int n=0;n<pages;n++)
+			{
+				if(chapterPages>0) compressedPages[n]=lz.compressPage(n,n/chapterPages*chapterPages);
+				else compressedPages[n]=lz.compressPage(n);
+			}
+		}
 
-			int[] partSig=new int[pl];
+		while(pagePointer<pages)
+		{
+			if(chapterPages>0 && pagePointer>=nextChapter)
+			{
+				cuePoints.add(signal.getLength());
+				cueLabels.add("page "+pagePointer);
+				signal.write(makeImageCommand(data));
+				nextChapter=pagePointer+chapterPages;
+			}
+			// the frames end at the chapter boundaries, so the chapters start at multiples of chapterPages
+			int lastPage=pages;
+			if(chapterPages>0) lastPage=Math.min(pages,nextChapter);
+			int[] partSig=compressedPages[pagePointer];
+			int numPages=1;
+			double pageTime=frameSetup.getProgrammingTime();
 			
-			for(int n=0;n<pl;n++)
+			if(compression)
 			{
-				if(n+sigPointer>data.length-1) partSig[n]=0xFF;
-				else partSig[n]=data[n+sigPointer];
-
+				// as many pages as fit into one frame
+				while(pagePointer+numPages<lastPage)
+				{
+					int[] next=compressedPages[pagePointer+numPages];
+					if(partSig.length+next.length>=pl) break;
+					int[] both=new int[partSig.length+next.length];
+					for(int n=0;n<partSig.length;n++) both[n]=partSig[n];
+					for(int n=0;n<next.length;n++) both[n+partSig.length]=next[n];
+					partSig=both;
+					numPages++;
+				}
 			}
 			
-			sigPointer+=pl;
-			double[] sig=generatePageSignal(partSig);
-			signal=appendSignal(signal,sig);
+			frameSetup.setPageIndex(pagePointer);
+			frameSetup.setProgCommand(); // we want to programm the mc
+			if(pagesPerFrame>1 && !(compression && partSig.length<pl))
+			{
+				numPages=Math.min(pagesPerFrame,lastPage-pagePointer);
+				writeMultiPageSignal(data,numPages,signal);
+				compressedSize+=numPages*pl;
+				frames++;
+				
+				// the last page is programmed after the frame
+				if(gaplessFrames) nextPreambleTime=getPageProgrammingTime();
+				else signal.write(silence(frameSetup.getSilenceBetweenPages()));
+				pagePointer+=numPages;
+				continue;
+			}
+			if(compression && partSig.length<pl)
+			{
+				airtimeSaved+=numPages*getFrameDuration();
+				frameSetup.setCompressedCommand();
+				frameSetup.setTotalLength(partSig.length);
+				airtimeSaved-=getFrameDuration();
+				pageTime=getPageProgrammingTime();
+			}
+			else // uncompressed
+			{
+				numPages=1;
+				frameSetup.setTotalLength(data.length);
+				partSig=new int[pl];
+				for(int n=0;n<pl;n++)
+				{
+					if(n+pagePointer*pl>data.length-1) partSig[n]=0xFF;
+					else partSig[n]=data[n+pagePointer*pl];
+				}
+			}
+			compressedSize+=partSig.length;
+			frames++;
+			
+			signal.write(generatePageSignal(partSig));
 
-			signal=appendSignal(signal,silence(frameSetup.getSilenceBetweenPages()));
+			// the bootloader erases and writes the pages after the frame has been received
+			if(gaplessFrames) nextPreambleTime=numPages*pageTime;
+			else signal.write(silence(numPages*frameSetup.getSilenceBetweenPages()));
 			
-			total-=pl;
+			pagePointer+=numPages;
+		}
+		
+		if(compression && pages>0)
+		{
+			System.out.println("compression: "+pages*pl+" bytes in "+compressedSize+" bytes, ratio "
+					+String.format("%.2f",(double)pages*pl/compressedSize)+", "+frames+" instead of "+pages+" frames, airtime saved "
+					+String.format("%.3f",airtimeSaved)+" s");
 		}
 
-		signal=appendSignal(signal,makeRunCommand()); // send mc "start the application"
+		if(eeprom!=null) writeEepromSignal(eeprom,signal);
+		
+		endFramePosition=signal.getLength();
+		if(pages>0) signal.write(makeRunCommand()); // send mc "start the application"
+		else signal.write(makeExitCommand());
+		frameSetup.setFec(fec);
 		// added silence at sound end to time out sound fading in some wav players like from Mircosoft
 		for(int k=0;k<10;k++)
 		{
-			signal=appendSignal(signal,silence(frameSetup.getSilenceBetweenPages()));
+			signal.write(silence(frameSetup.getSilenceBetweenPages()));
 		}
-		return signal;
 	}
 	
 	public boolean saveWav(double[] signal, File fileName)
@@ -140,6 +566,7 @@ public class WavCodeGenerator
 			long numFrames=signal.length;
 			// Create a wav file with the name specified as the first argument
 			WavFile wavFile = WavFile.newWavFile(fileName, 2, numFrames, 16, sampleRate);
+			for(int n=0;n<cuePoints.size();n++) wavFile.addCuePoint(cuePoints.get(n),cueLabels.get(n));
 
 			// Create a buffer of 100 frames
 			double[][] buffer = new double[2][100];
@@ -182,17 +609,178 @@ public class WavCodeGenerator
 		return true;
 	}
 	
-	public boolean convertHex2Wav(File hexFile, File wavFile) throws Exception
+	/* streaming: the frames are encoded straight into the file, the chunk sizes of the
+	 * header are written when the file is closed. The memory does not depend on the image size.
+	 */
+	public void writeWav(int data[], int eeprom[], File fileName) throws Exception
+	{
+		WavFile wavFile=WavFile.newWavFile(fileName,2,16,sampleRate);
+		WavFileSink sink=new WavFileSink(wavFile);
+		writeSignal(data,eeprom,sink);
+		for(int n=0;n<cuePoints.size();n++) wavFile.addCuePoint(cuePoints.get(n),cueLabels.get(n));
+		wavFile.close();
+	}
+	
+	/* two images in one stereo wav file: the left channel programs one device, the right channel
+	 * another one at the same time, e.g. two variants of a board on one jig. Both channels use
+	 * the settings of this generator. The shorter one gets silence before its RUN ( or EXIT ) frame,
+	 * so both devices start their programs at the same time. The signals are kept in memory,
+	 * chapters have no cue points.
+	 */
+	public void writeStereoWav(int left[], int eepromLeft[], int right[], int eepromRight[], File fileName) throws Exception
+	{
+		double[][] channels=new double[2][];
+		long[] endFrame=new long[2];
+		
+		channels[0]=generateSignal(left,eepromLeft);
+		endFrame[0]=endFramePosition;
+		channels[1]=generateSignal(right,eepromRight);
+		endFrame[1]=endFramePosition;
+		
+		int c=endFrame[0]<endFrame[1] ? 0 : 1;
+		int at=(int)endFrame[c];
+		int padding=(int)(endFrame[1-c]-endFrame[c]);
+		double[] padded=new double[channels[c].length+padding];
+		System.arraycopy(channels[c],0,padded,0,at);
+		System.arraycopy(channels[c],at,padded,at+padding,channels[c].length-at);
+		channels[c]=padded;
+		
+		// the fraction of a sample carried over by the encoder may differ by one sample at the end
+		int length=Math.max(channels[0].length,channels[1].length);
+		WavFile wavFile=WavFile.newWavFile(fileName,2,length,16,sampleRate);
+		WavFileSink sink=new WavFileSink(wavFile);
+		sink.write(Arrays.copyOf(channels[0],length),Arrays.copyOf(channels[1],length));
+		wavFile.close();
+	}
+	
+	/* streaming without a known length: the frames are written to the stream as soon as
+	 * they are encoded. wavHeader: the stream starts with a wav header of unknown size
+	 * ( stdout, named pipe ), otherwise it is raw PCM ( sound line ). Chapters have no
+	 * cue points in a stream.
+	 */
+	public void streamWav(int data[], int eeprom[], OutputStream out, boolean wavHeader) throws IOException
+	{
+		PcmStreamSink sink=new PcmStreamSink(out);
+		if(wavHeader) sink.writeWavHeader(sampleRate);
+		writeSignal(data,eeprom,sink);
+		out.flush();
+	}
+	
+	// plays the signal on the sound card while it is generated
+	public void playSignal(int data[], int eeprom[]) throws Exception
+	{
+		SoundLineStream line=new SoundLineStream(sampleRate);
+		try
+		{
+			streamWav(data,eeprom,line,false);
+		}
+		finally
+		{
+			line.close();
+		}
+	}
+	
+	// flash image of a hex file, the content is listed on System.out
+	public static int[] readHexFile(File hexFile) throws Exception
 	{
-		//IntelHexFormat ih=new IntelHexFormat();
 		byte[] erg = IntelHexFormat.IntelHexFormatToByteArray(hexFile);
 		IntelHexFormat.anzeigen(erg);
-		//WavCodeGenerator w=new WavCodeGenerator();
-		double[] signal=generateSignal(IntelHexFormat.toUnsignedIntArray(IntelHexFormat.discardHeaderBytes(erg)));
-		saveWav(signal,wavFile);
+		return IntelHexFormat.toUnsignedIntArray(IntelHexFormat.discardHeaderBytes(erg));
+	}
+	
+	/* EEPROM image of an eep file ( intel hex format ), -1 for the bytes not in the file
+	 * the file is read as blocks of 3 bytes length, 3 bytes address and the data
+	 */
+	public static int[] readEepromFile(File eepFile) throws Exception
+	{
+		int[] blocks=IntelHexFormat.toUnsignedIntArray(IntelHexFormat.IntelHexFormatToByteArray(eepFile));
+		int[] eeprom=new int[EEPROMSIZE];
+		
+		for(int n=0;n<EEPROMSIZE;n++) eeprom[n]=-1;
+		for(int n=0;n+6<=blocks.length;)
+		{
+			int length=(blocks[n]<<16)|(blocks[n+1]<<8)|blocks[n+2];
+			int address=(blocks[n+3]<<16)|(blocks[n+4]<<8)|blocks[n+5];
+			n+=6;
+			for(int k=0;k<length && n<blocks.length;k++,n++)
+			{
+				if(address+k>=EEPROMSIZE) throw new Exception("EEPROM address out of range: "+(address+k));
+				eeprom[address+k]=blocks[n];
+			}
+		}
+		return eeprom;
+	}
+	
+	/* the bootloader keeps its own data in the last EEPROM bytes: the resume state of a wav with
+	 * chapters is rejected, the fast start window ( a wav with lead in ) may be set on purpose
+	 */
+	public int[] checkEeprom(int eeprom[])
+	{
+		for(int n=RESUMESTATE;n<eeprom.length;n++)
+		{
+			if(chapterPages>0 && eeprom[n]>=0) throw new IllegalArgumentException("EEPROM byte "+n+": the bytes from "+RESUMESTATE+" on hold the resume state of USE_RESUME");
+		}
+		if(leadInTime>0 && eeprom.length>FASTSTARTCONFIG && eeprom[FASTSTARTCONFIG]>=0)
+		{
+			System.err.println("warning: EEPROM byte "+FASTSTARTCONFIG+" sets the start window of USE_FASTSTART to "+eeprom[FASTSTARTCONFIG]+" ms");
+		}
+		return eeprom;
+	}
+	
+	public boolean convertHex2Wav(File hexFile, File wavFile) throws Exception
+	{
+		return convertHex2Wav(hexFile,null,wavFile);
+	}
+	
+	// flash ( hexFile ) and EEPROM ( eepFile ) data in one wav file, one of them may be null
+	public boolean convertHex2Wav(File hexFile, File eepFile, File wavFile) throws Exception
+	{
+		int[] data=new int[0];
+		int[] eeprom=null;
+		
+		if(hexFile!=null) data=readHexFile(hexFile);
+		if(eepFile!=null) eeprom=checkEeprom(readEepromFile(eepFile));
+		writeWav(data,eeprom,wavFile);
 		return true;
 	}
 	
+	// two hex files ( and their EEPROM data, may be null ) on the left and right channel, see writeStereoWav()
+	public void convertHex2StereoWav(File leftHexFile, File leftEepFile, File rightHexFile, File rightEepFile, File wavFile) throws Exception
+	{
+		int[] left=new int[0];
+		int[] right=new int[0];
+		int[] eepromLeft=null;
+		int[] eepromRight=null;
+		
+		if(leftHexFile!=null) left=readHexFile(leftHexFile);
+		if(rightHexFile!=null) right=readHexFile(rightHexFile);
+		if(leftEepFile!=null) eepromLeft=checkEeprom(readEepromFile(leftEepFile));
+		if(rightEepFile!=null) eepromRight=checkEeprom(readEepromFile(rightEepFile));
+		writeStereoWav(left,eepromLeft,right,eepromRight,wavFile);
+	}
+	
+	// as convertHex2Wav(), but streamed, see streamWav()
+	public void convertHex2Stream(File hexFile, File eepFile, OutputStream out, boolean wavHeader) throws Exception
+	{
+		int[] data=new int[0];
+		int[] eeprom=null;
+		
+		if(hexFile!=null) data=readHexFile(hexFile);
+		if(eepFile!=null) eeprom=checkEeprom(readEepromFile(eepFile));
+		streamWav(data,eeprom,out,wavHeader);
+	}
+	
+	// as convertHex2Wav(), but played on the sound card while it is generated
+	public void playHex(File hexFile, File eepFile) throws Exception
+	{
+		int[] data=new int[0];
+		int[] eeprom=null;
+		
+		if(hexFile!=null) data=readHexFile(hexFile);
+		if(eepFile!=null) eeprom=checkEeprom(readEepromFile(eepFile));
+		playSignal(data,eeprom);
+	}
+	
 	public static void main(String[] args) throws Exception
 	{
    	    File f1 = new File("C:\\Dokumente und Einstellungen\\chris\\Eigene Dateien\\Entwicklung\\java\\EclipseWorkspace2\\wavBootLoader\\test.hex");
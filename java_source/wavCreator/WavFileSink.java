@@ -0,0 +1,57 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	signal written to both channels of a wav file, the number of frames
+	has to be known when the file is created, see WavCodeGenerator.writeWav()
+	or two signals of the same length, see WavCodeGenerator.writeStereoWav()
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+package wavCreator;
+
+import java.io.IOException;
+
+import waveFile.WavFile;
+import waveFile.WavFileException;
+
+public class WavFileSink implements SignalSink
+{
+	private WavFile wavFile;
+	private double[][] channels=new double[2][];
+	private long length=0;
+
+	public WavFileSink(WavFile wavFile)
+	{
+		this.wavFile=wavFile;
+	}
+
+	public void write(double[] signal) throws IOException
+	{
+		write(signal,signal);
+	}
+
+	public void write(double[] left, double[] right) throws IOException
+	{
+		if(left.length!=right.length) throw new IOException("channels of different length");
+		channels[0]=left;
+		channels[1]=right;
+		try
+		{
+			wavFile.writeFrames(channels,left.length);
+		}
+		catch(WavFileException e)
+		{
+			throw new IOException(e.getMessage());
+		}
+		length+=left.length;
+	}
+
+	public long getLength()
+	{
+		return length;
+	}
+}
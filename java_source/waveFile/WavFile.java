@@ -12,6 +12,7 @@ package waveFile;
 // Version 1.0
 
 import java.io.*;
+import java.util.ArrayList;
 
 public class WavFile
 {
@@ -22,6 +23,10 @@ public class WavFile
 	private final static int DATA_CHUNK_ID = 0x61746164;
 	private final static int RIFF_CHUNK_ID = 0x46464952;
 	private final static int RIFF_TYPE_ID = 0x45564157;
+	private final static int CUE_CHUNK_ID = 0x20657563;
+	private final static int LIST_CHUNK_ID = 0x5453494C;
+	private final static int ADTL_TYPE_ID = 0x6C746461;
+	private final static int LABL_CHUNK_ID = 0x6C62616C;
 
 	private File file;						// File that will be read from or written to
 	private IOState ioState;				// Specifies the IO State of the Wav File (used for snaity checking)
@@ -45,6 +50,11 @@ public class WavFile
 	private int bufferPointer;				// Points to the current position in local buffer
 	private int bytesRead;					// Bytes read after last read into local buffer
 	private long frameCounter;				// Current number of frames read or written
+	private boolean sizeUnknown;			// The chunk sizes are written when the file is closed
+
+	// Cue points, written after the data chunk when the file is closed
+	private ArrayList<Long> cuePositions = new ArrayList<Long>();
+	private ArrayList<String> cueLabels = new ArrayList<String>();
 
 	// Cannot instantiate WavFile directly, must either use newWavFile() or openWavFile()
 	private WavFile()
@@ -77,6 +87,13 @@ public class WavFile
 		return validBits;
 	}
 
+	// Marker at a frame position, shown by audio editors and players to jump to
+	public void addCuePoint(long frame, String label)
+	{
+		cuePositions.add(frame);
+		cueLabels.add(label);
+	}
+
 	public static WavFile newWavFile(File file, int numChannels, long numFrames, int validBits, long sampleRate) throws IOException, WavFileException
 	{
 		// Instantiate new Wavfile and initialise
@@ -171,6 +188,16 @@ public class WavFile
 		return wavFile;
 	}
 
+	// Number of frames not known in advance: the file takes any number of frames, the chunk
+	// sizes are corrected when it is closed
+	public static WavFile newWavFile(File file, int numChannels, int validBits, long sampleRate) throws IOException, WavFileException
+	{
+		WavFile wavFile = newWavFile(file, numChannels, 0, validBits, sampleRate);
+		wavFile.numFrames = Long.MAX_VALUE;
+		wavFile.sizeUnknown = true;
+		return wavFile;
+	}
+
 	public static WavFile openWavFile(File file) throws IOException, WavFileException
 	{
 		// Instantiate new Wavfile and store the file reference
@@ -673,9 +700,19 @@ public class WavFile
 			// Write out anything still in the local buffer
 			if (bufferPointer > 0) oStream.write(buffer, 0, bufferPointer);
 
+			if (sizeUnknown)
+			{
+				numFrames = frameCounter;
+				wordAlignAdjust = (blockAlign * numFrames) % 2 == 1;
+			}
+
 			// If an extra byte is required for word alignment, add it to the end
 			if (wordAlignAdjust) oStream.write(0);
 
+			if (sizeUnknown) writeChunkSizes();
+
+			if (cuePositions.size() > 0) writeCueChunks();
+
 			// Close the stream and set to null
 			oStream.close();
 			oStream = null;
@@ -685,6 +722,64 @@ public class WavFile
 		ioState = IOState.CLOSED;
 	}
 
+	// data and riff chunk size of a file created without the number of frames
+	private void writeChunkSizes() throws IOException
+	{
+		long fileSize = oStream.getChannel().position();
+
+		putLE(blockAlign * numFrames,	buffer, 0, 4);
+		oStream.getChannel().position(40);		// size of the data chunk, after the format chunk
+		oStream.write(buffer, 0, 4);
+		putLE(fileSize - 8,				buffer, 0, 4);
+		oStream.getChannel().position(4);
+		oStream.write(buffer, 0, 4);
+		oStream.getChannel().position(fileSize);
+	}
+
+	// cue chunk and a LIST adtl chunk with the labels, the riff chunk size is corrected
+	private void writeCueChunks() throws IOException
+	{
+		int n = cuePositions.size();
+		ByteArrayOutputStream labels = new ByteArrayOutputStream();
+
+		putLE(CUE_CHUNK_ID,	buffer, 0, 4);
+		putLE(4 + 24 * n,		buffer, 4, 4);
+		putLE(n,					buffer, 8, 4);
+		oStream.write(buffer, 0, 12);
+		for (int i=0 ; i<n ; i++)
+		{
+			long position = cuePositions.get(i);
+			putLE(i + 1,			buffer, 0, 4);		// Cue ID
+			putLE(position,		buffer, 4, 4);		// Play order position
+			putLE(DATA_CHUNK_ID,	buffer, 8, 4);		// Chunk containing the cue
+			putLE(0,					buffer, 12, 4);	// Chunk start
+			putLE(0,					buffer, 16, 4);	// Block start
+			putLE(position,		buffer, 20, 4);	// Sample offset
+			oStream.write(buffer, 0, 24);
+
+			byte[] text = cueLabels.get(i).getBytes("US-ASCII");
+			int size = 4 + text.length + 1;
+			putLE(LABL_CHUNK_ID,	buffer, 0, 4);
+			putLE(size,				buffer, 4, 4);
+			putLE(i + 1,			buffer, 8, 4);
+			labels.write(buffer, 0, 12);
+			labels.write(text);
+			labels.write(0);
+			if (size % 2 == 1) labels.write(0);
+		}
+
+		putLE(LIST_CHUNK_ID,		buffer, 0, 4);
+		putLE(4 + labels.size(),	buffer, 4, 4);
+		putLE(ADTL_TYPE_ID,		buffer, 8, 4);
+		oStream.write(buffer, 0, 12);
+		labels.writeTo(oStream);
+
+		long fileSize = oStream.getChannel().position();
+		putLE(fileSize - 8,		buffer, 0, 4);
+		oStream.getChannel().position(4);
+		oStream.write(buffer, 0, 4);
+	}
+
 	public void display()
 	{
 		display(System.out);